@@ -29,65 +29,78 @@
  * @author Iltikin Wayet
  */
 
-#include "cachelab.h"
+#include "csim.h"
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
-/**
- * @brief Data structure to hold cache basic information.
- *     Information defined by user.
- *
- * @arg s       : number of set index bits
- * @arg E       : number of lines per set
- * @arg b       : number of block bits
- * @arg set_num : number of sets
- * @arg v_flag  : verbose flag (true when -v option given)
- */
-typedef struct cache_info_struct *cache_info;
-struct cache_info_struct {
-    unsigned long int s;
-    unsigned long int E;
-    unsigned long int b;
-    unsigned long int set_num;
-    bool v_flag;
-};
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
 
 /**
- * @brief Queue of trace operations.
+ * @brief Queue of trace operations, run-length encoded.
  * First operation added to queue first to be executed.
  *
- * @arg address : memory address to be accessed
- * @arg size    : number of bytes to be accessed
+ *     One node holds a run of count operations of the same size and
+ *     kind whose addresses advance by a fixed stride; sequential and
+ *     strided sweeps, which dominate most traces, collapse to a
+ *     single node each. The replay loop expands runs on the fly.
+ *
+ * @arg address : memory address of the run's first operation
+ * @arg size    : number of bytes accessed by each operation
+ * @arg stride  : address delta between consecutive operations
+ * @arg count   : operations in the run (1 = a lone operation)
  * @arg store   : type of operation; true if 'S', false 'L'
- * @arg next    : pointer to next operation in queue
+ * @arg next    : pointer to next run in queue
  */
 typedef struct trace_struct *traces;
 struct trace_struct {
     unsigned long long address;
     unsigned long long size;
+    long long stride;
+    unsigned long long count;
     traces next;
     bool store;
 };
 
+/** @brief Trace nodes carved from each pool chunk. */
+#define TRACE_POOL_CHUNK 65536
+
 /**
- * @brief Basic unit of cache memory.
+ * @brief Chunk of pool-allocated trace queue nodes.
+ *     Nodes are carved sequentially out of large chunks instead of
+ *     being malloc'd one by one: allocation is a pointer bump, freeing
+ *     drops whole chunks, and queue order matches memory order so
+ *     iterating the queue walks linearly within each chunk.
  *
- * @arg tag      : tag value of the line
- * @arg order    : recency of line usage (greater is more recent)
- * @arg is_valid : cache line valid
- * @arg has_data : cache line not empty
+ * @arg next  : next chunk in the pool
+ * @arg used  : nodes carved from this chunk so far
+ * @arg nodes : node storage
  */
-typedef struct block_struct *block;
-struct block_struct {
-    unsigned long long tag;
-    unsigned long long order;
-    bool is_valid;
-    bool has_data;
+typedef struct trace_chunk_struct *trace_chunk;
+struct trace_chunk_struct {
+    trace_chunk next;
+    unsigned long int used;
+    struct trace_struct nodes[TRACE_POOL_CHUNK];
 };
 
+/** @brief Number of operations parsed per batch in streaming mode. */
+#define STREAM_BATCH 4096
+
 void help_msg(void) {
     printf("Usage:  ./csim -ref [-v] -s <s> -E <E> -b <b> -t <trace>\n"
            "        ./csim -ref -h\n\n"
@@ -97,38 +110,117 @@ void help_msg(void) {
            "    -s <s>        Number of set index bits (there are 2**s sets)\n"
            "    -b <b>        Number of block bits (there are 2**b blocks)\n"
            "    -E <E>        Number of lines per set (associativity)\n"
-           "    -t <trace>    File name of the memory trace to process\n\n"
+           "    -t <trace>    File name of the memory trace to process\n"
+           "    --stream      Simulate while parsing, in constant memory\n"
+           "                  (for traces too large to hold in heap)\n"
+           "    --sweep <f>   Replay the trace through every `s,E,b`\n"
+           "                  configuration listed in file f, one pass\n"
+           "                  (only -t is required; -s/-E/-b are ignored)\n"
+           "    --threads <n> Simulate with n set-sharded worker threads\n"
+           "                  (-v is ignored in this mode)\n"
+           "    --log <f>     Write a binary event log to file f instead of\n"
+           "                  verbose text (pretty-print with csim-logcat)\n"
+           "    --levels <l>  Simulate a multi-level hierarchy; l is a\n"
+           "                  comma-separated list of s:E:b geometries,\n"
+           "                  L1 first (only -t is required)\n"
+           "    --policy <p>  Replacement policy: lru (default), plru\n"
+           "                  (needs power-of-two E <= 64), rand, srrip\n"
+           "    --sample <n>  Simulate only 1 in n sets and scale the\n"
+           "                  counters up; estimates, with an error bound,\n"
+           "                  a run n times larger (1 simulates all sets)\n"
+           "    --save <f>    Write the final cache state and counters to\n"
+           "                  snapshot file f after simulation\n"
+           "    --resume <f>  Load cache state from snapshot file f and\n"
+           "                  skip the trace operations it covers (the\n"
+           "                  geometry and policy must match the snapshot)\n"
+           "    --stats <f>   Keep per-set and windowed hit/miss/eviction\n"
+           "                  counters, dumped to file f as CSV at the end\n"
+           "    --window <n>  Operations per --stats interval (default\n"
+           "                  1000000; 0 keeps per-set counters only)\n"
+           "    --prefetch <p> Model a hardware prefetcher on the miss\n"
+           "                  path: nextline or stride (PC-less stream\n"
+           "                  table); prefetch counters print after the\n"
+           "                  summary\n"
+           "    --shared <g>  Multi-core coherent mode: one -t trace per\n"
+           "                  core, each with a private MESI cache of the\n"
+           "                  -s/-E/-b geometry over a shared level of\n"
+           "                  `s:E:b` geometry g\n"
+           "    --batch <f>   Run every `s,E,b,trace` job listed in file f\n"
+           "                  on a thread pool in this one process\n"
+           "                  (--threads sizes the pool; default: online\n"
+           "                  cores) and print one summary per job\n"
+           "    --tlb <g>     Model a TLB consulted before the cache; g is\n"
+           "                  `entries:assoc:pagebits`, optionally extended\n"
+           "                  with `:entries:assoc` for a second level; TLB\n"
+           "                  counters print after the summary and misses\n"
+           "                  join the --time model (see --time)\n"
+           "    --victim <n>  Model an n-entry fully associative victim\n"
+           "                  buffer between the cache and memory (n <= 64);\n"
+           "                  swap counters print after the summary\n"
+           "    --stbuf <n>   Model an n-entry store buffer coalescing\n"
+           "                  retiring dirty lines (n <= 64); coalesce\n"
+           "                  counters print after the summary\n"
+           "    --hash <f>    Set-index function: raw (address bits,\n"
+           "                  default), xor (low tag bits folded into the\n"
+           "                  index), or skew (skewed-associative, one\n"
+           "                  index hash per way; lru only)\n"
+           "    --profile     Keep rdtsc cycle attribution across the run's\n"
+           "                  phases (kernel, TLB, side bookkeeping, trace\n"
+           "                  parsing, allocation, stream I/O) and a\n"
+           "                  tag-search depth histogram, printed after the\n"
+           "                  summary; compiled in, armed by one branch\n"
+           "    --results <f> Append one machine-readable JSON line per\n"
+           "                  run to file f: geometry, the five counters,\n"
+           "                  replay throughput, and the --time outputs\n"
+           "                  when that flag is armed; in --sweep and\n"
+           "                  --batch modes, one line per config or job\n"
+           "    --compare <old> <new>  Diff two --results files run by\n"
+           "                  run; flags any counter change and throughput\n"
+           "                  drops beyond the noise threshold, and exits\n"
+           "                  nonzero if anything was flagged\n"
+           "    --time[=h:m:w[:t]] Report total cycles and average memory\n"
+           "                  access time after the summary; h, m, w, t\n"
+           "                  override the hit, miss-penalty, writeback,\n"
+           "                  and TLB-miss cycle costs (default 4:100:100,\n"
+           "                  the grading costs from cachelab.h, and a\n"
+           "                  TLB walk costing one miss penalty)\n\n"
            "The -s, -b, -E, and -t options must be supplied for all "
            "simulations.\n");
 }
 
 /**
- * @brief Validates strtoul output.
+ * @brief Carves one trace node out of the pool.
+ *     Bumps the current chunk's fill count; allocates and links a new
+ *     chunk when the current one is exhausted.
  *
- * @param[in] x   : output value to be checked
- * @param[in] msg : error message to be printed if x invalid
+ * @param[in] pool   : head of the chunk list, updated as chunks grow
+ * @param[in] result : value modified if errors
+ *     2 if memory error allocating a chunk
  *
- * @return 1 : if invalid strtoul output
- * @return 0 : if valid strtoul output
+ * @return carved node, or NULL on memory error
  */
-int check_strtoul(unsigned long int x, const char *msg) {
-    int r = 0;
-    if ((errno == ERANGE && x == ULONG_MAX) || (errno != 0 && x == 0)) {
-        perror("strtoul");
-        r = 1;
+traces pool_node(trace_chunk *pool, int *result) {
+    if (*pool == NULL || (*pool)->used == TRACE_POOL_CHUNK) {
+        trace_chunk chunk = malloc(sizeof(struct trace_chunk_struct));
+        if (chunk == NULL) {
+            *result = 2;
+            return NULL;
+        }
+        chunk->used = 0;
+        chunk->next = *pool;
+        *pool = chunk;
     }
-    if ((signed long int)x < 0)
-        r = 1;
-    if (r == 1)
-        fprintf(stderr, "%s\n", msg);
-    return r;
+    return &(*pool)->nodes[(*pool)->used++];
 }
 
 /**
  * @brief Parses and validates trace file.
- *     Creates queue of trace operations.
+ *     Creates queue of trace operations, with nodes carved from the
+ *     caller's pool rather than malloc'd individually.
  *
  * @param[in] trace_file : text path of trace file
+ * @param[in] pool       : chunk pool backing the queue nodes
+ *     Caller frees the whole queue with trace_pool_free.
  * @param[in] result     : value modified if errors
  *     0 if no errors
  *     1 if trace format error
@@ -139,7 +231,7 @@ int check_strtoul(unsigned long int x, const char *msg) {
  *     Allocating queue items may result in memory error.
  *     Thus, must check result integer for error flags.
  */
-traces make_trace(const char *trace_file, int *result) {
+traces make_trace(const char *trace_file, trace_chunk *pool, int *result) {
     const int LINELEN = 40;
 
     FILE *tfp = fopen(trace_file, "rt");
@@ -152,71 +244,90 @@ traces make_trace(const char *trace_file, int *result) {
 
     char linebuf[LINELEN];
 
-    traces trace = malloc(sizeof(struct trace_struct));
-    if (trace == NULL) {
-        *result = 2;
-        return NULL;
-    }
-    traces curr = trace;
+    traces trace = NULL;
+    traces curr = NULL;
 
     while (fgets(linebuf, LINELEN, tfp) != NULL) {
 
-        if (linebuf[1] != ' ' || linebuf[2] == ' ' ||
-            (linebuf[0] != 'S' && linebuf[0] != 'L') ||
-            strlen(&linebuf[0]) < 5) {
-            fprintf(stderr, "Invalid trace format\n");
-            *result = 1;
-            return trace;
-        }
-        bool op = (linebuf[0] == 'S');
-
-        char *tok = strtok(&linebuf[1], ",");
-        errno = 0;
-        unsigned long long ad = strtoul(tok, NULL, 16);
-        if (check_strtoul(ad, "Invalid address input.") == 1) {
+        trace_op op;
+        if (parse_trace_line(linebuf, &op) == 1) {
             *result = 1;
             return trace;
         }
 
-        tok = strtok(NULL, ",");
-        errno = 0;
-        unsigned long long sz = strtoul(tok, NULL, 0);
-        if (check_strtoul(sz, "Invalid size input.") == 1) {
-            *result = 1;
-            return trace;
+        // run-length coalescing: an operation repeating the previous
+        // node's size and kind at a fixed address delta extends the
+        // node instead of taking a new one
+        if (curr != NULL && op.size == curr->size &&
+            op.store == curr->store) {
+            if (curr->count == 1) {
+                curr->stride = (long long)(op.address - curr->address);
+                curr->count = 2;
+                continue;
+            }
+            if (op.address ==
+                curr->address + (unsigned long long)((long long)curr->count *
+                                                     curr->stride)) {
+                curr->count++;
+                continue;
+            }
         }
 
-        traces temp = malloc(sizeof(struct trace_struct));
-        if (temp == NULL) {
-            *result = 2;
+        traces temp = pool_node(pool, result);
+        if (temp == NULL)
             return trace;
-        }
-        temp->address = ad;
-        temp->size = sz;
-        temp->store = op;
-        curr->next = temp;
+        temp->address = op.address;
+        temp->size = op.size;
+        temp->stride = 0;
+        temp->count = 1;
+        temp->store = op.store;
+        temp->next = NULL;
+        if (curr == NULL)
+            trace = temp;
+        else
+            curr->next = temp;
         curr = temp;
     }
-    traces temp = trace;
-    trace = trace->next;
-    free(temp);
 
     fclose(tfp);
     return trace;
 }
 
-void trace_free(traces trace) {
-    traces curr = trace;
+void trace_pool_free(trace_chunk pool) {
+    trace_chunk curr = pool;
     while (curr != NULL) {
-        trace = curr->next;
+        pool = curr->next;
         free(curr);
-        curr = trace;
+        curr = pool;
+    }
+}
+
+/**
+ * @brief Links each set's LRU list into its initial chain.
+ *     Each set starts as the chain 0 (MRU) through E-1 (LRU); shared
+ *     by allocation and reset.
+ *
+ * @param[in] info : struct containing cache info defined by user
+ * @param[in] c    : cache whose list arrays are (re)initialized
+ */
+void lru_chains_init(cache_info info, cache c) {
+    for (unsigned long int i = 0; i < info->set_num; i++) {
+        unsigned long int base = i * info->E;
+        for (unsigned long int j = 0; j < info->E; j++) {
+            c->lru_prev[base + j] = (unsigned int)(j - 1);
+            c->lru_next[base + j] = (unsigned int)(j + 1);
+        }
+        c->lru_head[i] = 0;
+        c->lru_tail[i] = (unsigned int)(info->E - 1);
     }
 }
 
 /**
- * @brief Allocates matrix representation of cache.
- *     Block is the smallest unit of the matrix (correct term is line).
+ * @brief Allocates flat matrix representation of cache.
+ *     One contiguous allocation per field (struct-of-arrays), rather
+ *     than one allocation per line: for large s and E this is four
+ *     allocations total instead of millions, and the hot search loops
+ *     in simulator() stream linearly through memory.
  *
  * @param[in] info   : struct containing cache info defined by user
  *     Cache to be made according to these specifications.
@@ -229,284 +340,4529 @@ void trace_free(traces trace) {
  *     Thus must be sure to check result integer value.
  * @return NULL if memory error with initial allocate
  */
-block **make_cache(cache_info info, int *result) {
-    unsigned long int set_num = info->set_num;
-    unsigned long int E = info->E;
+cache make_cache(cache_info info, int *result) {
+    unsigned long int line_num = info->set_num * info->E;
 
-    block **ret_val = calloc(sizeof(block *), set_num);
+    cache ret_val = calloc(sizeof(struct cache_struct), 1);
     if (ret_val == NULL) {
         *result = 1;
         return NULL;
     }
 
-    for (unsigned long int i = 0; i < set_num; i++) {
-        ret_val[i] = calloc(sizeof(block), E);
-        if (ret_val[i] == NULL) {
+    ret_val->tag = calloc(sizeof(unsigned long long), line_num);
+    ret_val->order = calloc(sizeof(unsigned long long), line_num);
+    ret_val->is_valid = calloc(sizeof(bool), line_num);
+    ret_val->has_data = calloc(sizeof(bool), line_num);
+    if (ret_val->tag == NULL || ret_val->order == NULL ||
+        ret_val->is_valid == NULL || ret_val->has_data == NULL) {
+        *result = 1;
+        return ret_val;
+    }
+
+    if (info->policy == POLICY_PLRU) {
+        ret_val->plru = calloc(sizeof(unsigned long long), info->set_num);
+        if (ret_val->plru == NULL) {
             *result = 1;
             return ret_val;
         }
+    }
+    if (info->policy == POLICY_SRRIP) {
+        ret_val->rrpv = calloc(sizeof(unsigned char), line_num);
+        if (ret_val->rrpv == NULL) {
+            *result = 1;
+            return ret_val;
+        }
+    }
+    ret_val->rand_state = 0x9E3779B97F4A7C15ULL; // fixed seed: runs repeat
 
-        for (unsigned long int j = 0; j < E; j++) {
-            ret_val[i][j] = calloc(sizeof(struct block_struct), 1);
-            if (ret_val[i][j] == NULL) {
-                *result = 1;
-                return ret_val;
-            }
+    if (info->policy == POLICY_LRU && info->E >= LRU_LIST_MIN_E) {
+        ret_val->lru_prev = calloc(sizeof(unsigned int), line_num);
+        ret_val->lru_next = calloc(sizeof(unsigned int), line_num);
+        ret_val->lru_head = calloc(sizeof(unsigned int), info->set_num);
+        ret_val->lru_tail = calloc(sizeof(unsigned int), info->set_num);
+        if (ret_val->lru_prev == NULL || ret_val->lru_next == NULL ||
+            ret_val->lru_head == NULL || ret_val->lru_tail == NULL) {
+            *result = 1;
+            return ret_val;
         }
+
+        lru_chains_init(info, ret_val);
     }
     return ret_val;
 }
 
-void cache_free(cache_info info, block **cache) {
-    unsigned long int set_num = info->set_num;
-    unsigned long int E = info->E;
-    for (unsigned long int i = 0; i < set_num; i++) {
-        for (unsigned long int j = 0; j < E; j++)
-            free(cache[i][j]);
-        free(cache[i]);
-    }
-    free(cache);
+/**
+ * @brief Returns a cache to its just-allocated state.
+ *     Clears the line arrays and policy state in place so a cache can
+ *     be replayed into again by another simulation of identical
+ *     geometry without a new round of allocations.
+ *
+ * @param[in] info : struct containing cache info defined by user
+ * @param[in] c    : cache to reset, allocated with the same geometry
+ */
+void cache_reset(cache_info info, cache c) {
+    unsigned long int line_num = info->set_num * info->E;
+    memset(c->tag, 0, sizeof(unsigned long long) * line_num);
+    memset(c->order, 0, sizeof(unsigned long long) * line_num);
+    memset(c->is_valid, 0, sizeof(bool) * line_num);
+    memset(c->has_data, 0, sizeof(bool) * line_num);
+    if (c->plru != NULL)
+        memset(c->plru, 0, sizeof(unsigned long long) * info->set_num);
+    if (c->rrpv != NULL)
+        memset(c->rrpv, 0, sizeof(unsigned char) * line_num);
+    c->rand_state = 0x9E3779B97F4A7C15ULL; // fixed seed: runs repeat
+    if (c->lru_prev != NULL)
+        lru_chains_init(info, c);
+}
+
+void cache_free(cache c) {
+    free(c->tag);
+    free(c->order);
+    free(c->is_valid);
+    free(c->has_data);
+    free(c->lru_prev);
+    free(c->lru_next);
+    free(c->lru_head);
+    free(c->lru_tail);
+    free(c->plru);
+    free(c->rrpv);
+    free(c);
 }
 
 /**
- * @brief Simulates cache behavior.
- *     With every trace operation:
- *         1. Checks for hit
- *         2. If miss, checks for eviction
- *         3. Prints if verbose flag raised
+ * @brief Effective set index of an address under the index hash.
+ *     The side-band paths that map an address to its set (set
+ *     sharding, set sampling, per-set stats, prefetch probes) must
+ *     agree with the simulation kernels, so the XOR fold lives here.
+ *     HASH_SKEW gives a block no single set -- each way indexes its
+ *     own row -- and is rejected wherever this helper would be needed.
  *
- * @param[in] info   : struct containing cache info defined by user
- * @param[in] trace  : queue of trace operations executed by function
- * @param[in] cache  : 2d matrix representation of cache
- * @param[in] result : value modified if errors
- *     0 if no errors
- *     2 if memory error
+ * @param[in] info    : struct containing cache info defined by user
+ * @param[in] address : memory address being mapped
  *
- * @return NULL if memory allocation error
- * @return struct of statistics from simulation
- *     Counts of hits, misses, evictions, dirty bytes, dirty evictions
+ * @return set index the kernels use for the address
  */
-csim_stats_t *simulator(cache_info info, traces trace, block **cache,
-                        int *result) {
+static inline unsigned long long hash_index(cache_info info,
+                                            unsigned long long address) {
+    unsigned long long mask = ~(~0ULL << info->s);
+    unsigned long long set_index = (address >> info->b) & mask;
+    if (info->hash == HASH_XOR)
+        set_index ^= (address >> (info->s + info->b)) & mask;
+    return set_index;
+}
 
-    unsigned long int s = info->s;
-    unsigned long int E = info->E;
-    unsigned long int b = info->b;
+/**
+ * @brief Points a set's PLRU tree bits away from the touched way.
+ *     The E-1 internal nodes of the binary tree over the ways live in
+ *     one word per set, heap-numbered from 1; bit n tells which child
+ *     of node n is colder. Touching a way flips the bits on its
+ *     root-to-leaf path to face the other child.
+ *
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] E         : number of lines per set (power of two)
+ * @param[in] set_index : set holding the touched line
+ * @param[in] way       : way of the touched line within the set
+ */
+void plru_touch(cache c, unsigned long int E, unsigned long long set_index,
+                unsigned long int way) {
+    unsigned long long bits = c->plru[set_index];
+    unsigned long int node = 1;
+    for (unsigned long int half = E >> 1; half > 0; half >>= 1) {
+        unsigned long int dir = (way & half) ? 1 : 0;
+        if (dir)
+            bits &= ~(1ULL << node); // cold side is now the left child
+        else
+            bits |= 1ULL << node;
+        node = 2 * node + dir;
+    }
+    c->plru[set_index] = bits;
+}
 
-    unsigned long long set_index;
-    unsigned long long tag_value;
-    unsigned long long trace_num = 0;
+/**
+ * @brief Follows a set's PLRU tree bits down to the victim way.
+ *
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] E         : number of lines per set (power of two)
+ * @param[in] set_index : set to pick a victim from
+ *
+ * @return way of the pseudo-least-recently-used line
+ */
+unsigned long int plru_victim(cache c, unsigned long int E,
+                              unsigned long long set_index) {
+    unsigned long long bits = c->plru[set_index];
+    unsigned long int node = 1;
+    unsigned long int way = 0;
+    for (unsigned long int half = E >> 1; half > 0; half >>= 1) {
+        unsigned long int dir = (bits >> node) & 1;
+        if (dir)
+            way |= half;
+        node = 2 * node + dir;
+    }
+    return way;
+}
 
-    csim_stats_t *ret_val = calloc(sizeof(csim_stats_t), 1);
-    if (ret_val == NULL) {
-        *result = 2;
-        return NULL;
+/**
+ * @brief Picks an SRRIP victim from a set.
+ *     Scans for a line predicted for re-reference in the distant
+ *     future (RRPV 3); if none exists, ages the whole set and rescans.
+ *     Always terminates since aging saturates at RRPV 3.
+ *
+ * @param[in] rrpv : re-reference values of the set (E entries)
+ * @param[in] E    : number of lines per set
+ *
+ * @return way of the victim line
+ */
+unsigned long int srrip_victim(unsigned char *rrpv, unsigned long int E) {
+    for (;;) {
+        for (unsigned long int i = 0; i < E; i++)
+            if (rrpv[i] == 3)
+                return i;
+        for (unsigned long int i = 0; i < E; i++)
+            rrpv[i]++;
     }
+}
 
-    traces curr = trace;
-    while (curr != NULL) {
-        set_index = (curr->address & (~(~0ULL << s)) << b) >> b;
-        tag_value = curr->address >> (s + b);
-
-        block *set = cache[set_index];
-
-        bool hit = false;
-        unsigned long int hit_line;
-        bool empty = false;
-        unsigned long int mpt_line;
-
-        // looks for line with tag
-        for (unsigned long int i = 0; !hit && i < E; i++) {
-            if (set[i]->tag == tag_value && set[i]->is_valid)
-                hit = true;
-            if (hit)
-                hit_line = i;
-        }
-
-        if (hit) {
-            if (curr->store && !(set[hit_line]->has_data)) {
-                ret_val->dirty_bytes += 1UL << b;
-                set[hit_line]->has_data = true;
-            }
-            set[hit_line]->order = trace_num;
-            ret_val->hits++;
-        } else { // then we have a miss
-            ret_val->misses++;
-
-            for (unsigned long int i = 0; !empty && i < E; i++) {
-                if (!(set[i]->is_valid))
-                    empty = true;
-                if (empty)
-                    mpt_line = i;
-            }
-
-            if (empty) {
-                set[mpt_line]->tag = tag_value;
-                set[mpt_line]->is_valid = true;
-                set[mpt_line]->order = trace_num;
-                set[mpt_line]->has_data = false;
-                if (curr->store && !(set[mpt_line]->has_data)) {
-                    ret_val->dirty_bytes += 1UL << b;
-                    set[mpt_line]->has_data = true;
-                }
-            } else {
-                ret_val->evictions++;
+/**
+ * @brief Moves a way to the MRU position of its set's LRU list.
+ *     O(1): unlink the way from its current list position and relink
+ *     it in front of the current head. Only called when the cache was
+ *     allocated with LRU lists (E >= LRU_LIST_MIN_E).
+ *
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] E         : number of lines per set
+ * @param[in] set_index : set holding the touched line
+ * @param[in] way       : way of the touched line within the set
+ */
+void lru_touch(cache c, unsigned long int E, unsigned long long set_index,
+               unsigned int way) {
+    if (c->lru_head[set_index] == way)
+        return;
 
-                unsigned long int least_used = 0;
-                for (unsigned long int i = 0; i < E; i++) {
-                    if ((set[i]->order) < (set[least_used]->order))
-                        least_used = i;
-                }
+    unsigned long long base = set_index * E;
+    unsigned int prev = c->lru_prev[base + way];
+    unsigned int next = c->lru_next[base + way];
 
-                if (set[least_used]->has_data) {
-                    ret_val->dirty_evictions += 1UL << b;
-                    ret_val->dirty_bytes -= 1UL << b;
-                }
+    // unlink; way != head, so prev is always a real way
+    c->lru_next[base + prev] = next;
+    if (c->lru_tail[set_index] == way)
+        c->lru_tail[set_index] = prev;
+    else
+        c->lru_prev[base + next] = prev;
 
-                set[least_used]->tag = tag_value;
-                set[least_used]->order = trace_num;
-                set[least_used]->has_data = false;
-                if (curr->store && !(set[least_used]->has_data)) {
-                    ret_val->dirty_bytes += 1UL << b;
-                    set[least_used]->has_data = true;
-                }
-            }
-        }
+    // relink in front of the old head
+    unsigned int head = c->lru_head[set_index];
+    c->lru_prev[base + head] = way;
+    c->lru_next[base + way] = head;
+    c->lru_head[set_index] = way;
+}
 
-        if (info->v_flag) {
-            char op = curr->store ? 'S' : 'L';
-            printf("%c %llu,%llu ", op, curr->address, curr->size);
-            if (!hit) {
-                printf("miss ");
-                if (!empty)
-                    printf("eviction ");
-            } else
-                printf("hit ");
-            printf("\n");
-        }
-        curr = curr->next;
-        trace_num++;
+/** @brief Size of the verbose-log staging buffer in bytes. */
+#define LOG_BUF_SIZE (1UL << 20)
+
+/**
+ * @brief Buffered logging backend behind the -v and --log options.
+ *     Per-operation output is staged into a large user-space buffer
+ *     and written out in LOG_BUF_SIZE chunks, so the hot loop pays a
+ *     few stores per operation instead of a locked printf. In text
+ *     mode (-v) the buffer holds formatted lines bound for stdout; in
+ *     binary mode (--log) it holds packed log_rec events bound for
+ *     the log file, which csim-logcat can pretty-print offline.
+ *
+ * @arg buf    : staging buffer, NULL while logging is off
+ * @arg len    : bytes currently staged
+ * @arg out    : destination stream
+ * @arg binary : true when staging log_rec events instead of text
+ */
+struct log_backend {
+    char *buf;
+    size_t len;
+    FILE *out;
+    bool binary;
+};
+struct log_backend logger = {NULL, 0, NULL, false};
+
+/**
+ * @brief Writes out everything currently staged in the log buffer.
+ */
+void log_flush(void) {
+    if (logger.len > 0) {
+        fwrite(logger.buf, 1, logger.len, logger.out);
+        logger.len = 0;
     }
-    return ret_val;
 }
 
 /**
- * @brief Parses command line arguments, executes simulation accordingly.
- *     Initially stores all info into cache_info.
- *     Then creates trace, cache, simulation in order.
+ * @brief Opens the logging backend.
+ *     Text mode buffers verbose lines for stdout. Binary mode writes
+ *     the event-log magic and buffers log_rec events for log_file.
  *
- * @param[in] argc : Length of command line input
- * @param[in] argv : Command line input string
+ * @param[in] log_file : path of binary event log, or NULL for text
  *
- * @return 1 if errors in execution.
- * @return 0 if no errors in execution.
+ * @return 1 : if file or memory error
+ * @return 0 : if backend ready
  */
-int main(int argc, char **argv) {
-    cache_info info = malloc(sizeof(struct cache_info_struct));
-
-    info->s = 0;
-    info->E = 0;
-    info->b = 0;
-    info->v_flag = false;
-
-    bool h_flag = false;
-    int opt_n = 0;
-    int opt;
-    char *filename;
-
-    do {
-        opt = getopt(argc, argv, "hvs:b:E:t:");
-        switch (opt) {
-        case 'h':
-            h_flag = true;
-            opt = -1;
-            break;
-        case 'v':
-            info->v_flag = true;
-            break;
-        case 's':
-            errno = 0;
-            info->s = strtoul(optarg, NULL, 0);
-            if (check_strtoul(info->s, "Invalid option argument -- 's'") == 1)
-                return 1;
-            opt_n++;
-            break;
-        case 'E':
-            errno = 0;
-            info->E = strtoul(optarg, NULL, 0);
-            if (check_strtoul(info->E, "Invalid option argument -- 'E'") == 1 ||
-                (signed long int)info->E == 0)
-                return 1;
-            opt_n++;
-            break;
-        case 'b':
-            errno = 0;
-            info->b = strtoul(optarg, NULL, 0);
-            if (check_strtoul(info->b, "Invalid option argument -- 'b'") == 1)
-                return 1;
-            opt_n++;
-            break;
-        case 't':
-            filename = optarg;
-            opt_n++;
-            break;
-        default:
-            opt = -1;
-        }
-    } while (opt != -1);
-
-    if (h_flag) {
-        printf("csim.c info:\n");
-        help_msg();
+int log_open(const char *log_file) {
+    logger.buf = malloc(LOG_BUF_SIZE);
+    if (logger.buf == NULL)
         return 1;
+    logger.len = 0;
+
+    if (log_file == NULL) {
+        logger.out = stdout;
+        logger.binary = false;
+        return 0;
     }
-    if (opt_n != 4) {
-        printf("Mandatory arguments missing or zero.\n");
-        help_msg();
+
+    logger.out = fopen(log_file, "wb");
+    if (logger.out == NULL) {
+        fprintf(stderr, "Error opening '%s': %s\n", log_file,
+                strerror(errno));
+        free(logger.buf);
+        logger.buf = NULL;
         return 1;
     }
-    if (info->s + info->b > 64) {
-        fprintf(stderr, "Arguments s, b represent > 64 addressable bits.\n");
-        return 1;
+    logger.binary = true;
+    fwrite(LOG_MAGIC, 1, TRACE_MAGIC_LEN, logger.out);
+    return 0;
+}
+
+/**
+ * @brief Flushes and closes the logging backend.
+ */
+void log_close(void) {
+    if (logger.buf == NULL)
+        return;
+    log_flush();
+    if (logger.binary)
+        fclose(logger.out);
+    free(logger.buf);
+    logger.buf = NULL;
+}
+
+/**
+ * @brief Records the outcome of one simulated operation.
+ *     Appends either a formatted verbose line or a packed log_rec to
+ *     the staging buffer, flushing when the buffer is near full.
+ *
+ * @param[in] op    : operation that was simulated
+ * @param[in] hit   : whether the access hit
+ * @param[in] empty : whether a miss filled an empty line (no eviction)
+ */
+void log_event(const trace_op *op, bool hit, bool empty) {
+    if (logger.binary) {
+        if (logger.len + sizeof(log_rec) > LOG_BUF_SIZE)
+            log_flush();
+        log_rec rec = {op->address,  (unsigned int)op->size,
+                       op->store,    hit,
+                       !hit && !empty, 0};
+        memcpy(&logger.buf[logger.len], &rec, sizeof(log_rec));
+        logger.len += sizeof(log_rec);
+        return;
     }
 
-    info->set_num = 1UL << (info->s);
+    // longest line: "S 18446744073709551615,... miss eviction \n"
+    if (logger.len + 64 > LOG_BUF_SIZE)
+        log_flush();
+    char op_char = op->store ? 'S' : 'L';
+    const char *outcome = hit ? "hit " : (empty ? "miss " : "miss eviction ");
+    logger.len += (size_t)sprintf(&logger.buf[logger.len], "%c %llu,%llu %s\n",
+                                  op_char, op->address, op->size, outcome);
+}
 
-    // Above this point parsing command line into cache_info. Below simulation
+/** @brief Default interval length, in operations, for --stats windows. */
+#define ISTATS_WINDOW_DEFAULT 1000000
 
-    int trace_result = 0;
-    traces trace = make_trace(filename, &trace_result);
-    if (trace_result != 0) {
-        if (trace_result == 1)
-            fprintf(stderr, "Error in trace file -- %s\n", filename);
-        else // trace_result == 2
-            fprintf(stderr, "Memory error when allocating trace.");
-        if (trace != NULL)
-            trace_free(trace);
+/**
+ * @brief Instrumentation counters behind --stats.
+ *     Per-set hit/miss/eviction counters indexed by set_index, plus a
+ *     running interval that is closed and appended to a growable list
+ *     every window operations. Bumps are plain array increments so the
+ *     counters are cheap enough to leave on in full-speed runs.
+ */
+static struct {
+    bool active;                    /* counters are being kept */
+    unsigned long long *set_hits;   /* indexed by set_index */
+    unsigned long long *set_misses; /* indexed by set_index */
+    unsigned long long *set_evictions; /* indexed by set_index */
+    unsigned long long window;      /* operations per interval; 0 = off */
+    unsigned long long win_ops;     /* operations in the open interval */
+    unsigned long long win_hits;
+    unsigned long long win_misses;
+    unsigned long long win_evictions;
+    unsigned long long *intervals;  /* 3 counters per closed interval */
+    unsigned long long interval_num;
+    unsigned long long interval_cap;
+    const char *path;               /* dump written here at close */
+} istats;
+
+/**
+ * @brief Allocates the per-set counters and arms --stats.
+ *
+ * @param[in] info   : struct containing cache info defined by user
+ * @param[in] path   : file the dump is written to at close
+ * @param[in] window : operations per interval (0 disables intervals)
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int istats_open(cache_info info, const char *path,
+                unsigned long long window) {
+    istats.set_hits = calloc(sizeof(unsigned long long), info->set_num);
+    istats.set_misses = calloc(sizeof(unsigned long long), info->set_num);
+    istats.set_evictions = calloc(sizeof(unsigned long long), info->set_num);
+    if (istats.set_hits == NULL || istats.set_misses == NULL ||
+        istats.set_evictions == NULL) {
+        fprintf(stderr, "Memory error when allocating stats counters.");
+        free(istats.set_hits);
+        free(istats.set_misses);
+        free(istats.set_evictions);
         return 1;
     }
+    istats.window = window;
+    istats.path = path;
+    istats.active = true;
+    return 0;
+}
 
-    int cache_result = 0;
-    block **cache = make_cache(info, &cache_result);
-    if (cache_result != 0) {
-        fprintf(stderr, "Memory error when allocating cache.");
-        if (cache != NULL)
-            cache_free(info, cache);
-        return 1;
+/**
+ * @brief Closes the open interval and appends it to the list.
+ *     Grows the list by doubling; on memory failure interval tracking
+ *     is dropped (window set to 0) but per-set counters stay live.
+ */
+void istats_interval_close(void) {
+    if (istats.interval_num == istats.interval_cap) {
+        unsigned long long cap =
+            istats.interval_cap == 0 ? 64 : istats.interval_cap * 2;
+        unsigned long long *grown =
+            realloc(istats.intervals, sizeof(unsigned long long) * 3 * cap);
+        if (grown == NULL) {
+            fprintf(stderr, "Memory error when recording stats interval.");
+            istats.window = 0;
+            return;
+        }
+        istats.intervals = grown;
+        istats.interval_cap = cap;
     }
+    unsigned long long *rec = &istats.intervals[istats.interval_num * 3];
+    rec[0] = istats.win_hits;
+    rec[1] = istats.win_misses;
+    rec[2] = istats.win_evictions;
+    istats.interval_num++;
+    istats.win_ops = 0;
+    istats.win_hits = 0;
+    istats.win_misses = 0;
+    istats.win_evictions = 0;
+}
 
-    int simulator_result = 0;
-    csim_stats_t *simulated = simulator(info, trace, cache, &simulator_result);
-    if (simulator_result != 0) {
-        fprintf(stderr, "Memory error when running simulator.");
-        return 1;
+/**
+ * @brief Bumps the counters for one simulated operation.
+ *
+ * @param[in] info     : struct containing cache info defined by user
+ * @param[in] op       : operation that was simulated
+ * @param[in] hit      : whether the access hit
+ * @param[in] eviction : whether the access evicted a line
+ */
+static inline void istats_bump(cache_info info, const trace_op *op, bool hit,
+                               bool eviction) {
+    unsigned long long set_index = hash_index(info, op->address);
+    istats.set_hits[set_index] += hit;
+    istats.set_misses[set_index] += !hit;
+    istats.set_evictions[set_index] += eviction;
+    istats.win_hits += hit;
+    istats.win_misses += !hit;
+    istats.win_evictions += eviction;
+    if (++istats.win_ops == istats.window)
+        istats_interval_close();
+}
+
+/**
+ * @brief Dumps the counters as CSV and releases them.
+ *     One `set,<index>,<hits>,<misses>,<evictions>` line per set, then
+ *     one `interval,<index>,...` line per window in trace order; a
+ *     partial trailing window is included. No-op unless --stats armed.
+ *
+ * @param[in] info : struct containing cache info defined by user
+ */
+void istats_close(cache_info info) {
+    if (!istats.active)
+        return;
+    FILE *out = fopen(istats.path, "wt");
+    if (!out) {
+        fprintf(stderr, "Error opening '%s': %s\n", istats.path,
+                strerror(errno));
+    } else {
+        fprintf(out, "# csim stats: kind,index,hits,misses,evictions\n");
+        for (unsigned long int i = 0; i < info->set_num; i++)
+            fprintf(out, "set,%lu,%llu,%llu,%llu\n", i, istats.set_hits[i],
+                    istats.set_misses[i], istats.set_evictions[i]);
+        if (istats.window > 0 && istats.win_ops > 0)
+            istats_interval_close();
+        for (unsigned long long i = 0; i < istats.interval_num; i++)
+            fprintf(out, "interval,%llu,%llu,%llu,%llu\n", i,
+                    istats.intervals[i * 3], istats.intervals[i * 3 + 1],
+                    istats.intervals[i * 3 + 2]);
+        fclose(out);
     }
-    printSummary(simulated);
+    free(istats.set_hits);
+    free(istats.set_misses);
+    free(istats.set_evictions);
+    free(istats.intervals);
+    memset(&istats, 0, sizeof(istats));
+}
 
-    trace_free(trace);
-    cache_free(info, cache);
-    free(info);
-    free(simulated);
+/**
+ * @brief Searches a set for a valid line holding the given tag.
+ *     The tags of a set are contiguous, so on AVX2 hardware the search
+ *     compares four 64-bit tags per vector instruction and only falls
+ *     back to scalar checks for lanes whose tags match (validity is
+ *     rare enough to check after the compare). Without AVX2 the
+ *     portable scalar loop is used. Both return the lowest matching
+ *     way, matching the original scan order.
+ *
+ * @param[in] tag       : tag array of the set (E entries)
+ * @param[in] is_valid  : valid bits of the set (E entries)
+ * @param[in] E         : number of lines per set
+ * @param[in] tag_value : tag to search for
+ * @param[in] hit       : set true if a valid matching line was found
+ *
+ * @return way of the matching line; meaningless if *hit is false
+ */
+unsigned long int tag_search(const unsigned long long *tag,
+                             const bool *is_valid, unsigned long int E,
+                             unsigned long long tag_value, bool *hit) {
+    unsigned long int i = 0;
+
+#ifdef __AVX2__
+    __m256i want = _mm256_set1_epi64x((long long)tag_value);
+    for (; i + 4 <= E; i += 4) {
+        __m256i tags = _mm256_loadu_si256((const __m256i *)&tag[i]);
+        int mask = _mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(tags, want)));
+        while (mask != 0) {
+            unsigned long int lane = (unsigned long int)__builtin_ctz(mask);
+            if (is_valid[i + lane]) {
+                *hit = true;
+                return i + lane;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
 
+    for (; i < E; i++) {
+        if (tag[i] == tag_value && is_valid[i]) {
+            *hit = true;
+            return i;
+        }
+    }
+    *hit = false;
     return 0;
 }
+
+/**
+ * @brief Policy-parameterized body of simulate_op.
+ *     1. Checks for hit
+ *     2. If miss, checks for eviction
+ *     3. Prints if verbose flag raised
+ *
+ *     The policy and assoc arguments are compile-time constants at
+ *     every call site in simulate_op's dispatch switch, so the
+ *     optimizer emits one specialized kernel per combination with the
+ *     policy branches folded away and the search loops unrolled for
+ *     the common associativities — no per-operation indirect call.
+ *     assoc == 1 takes a dedicated direct-mapped path with no loops
+ *     at all: there is exactly one candidate line.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters updated by the operation
+ * @param[in] op        : decoded trace operation to perform
+ * @param[in] trace_num : position of operation within the trace
+ * @param[in] policy    : replacement policy to apply
+ * @param[in] assoc     : associativity to specialize for, 0 = generic
+ * @param[in] hash      : set-index function to apply
+ *
+ * @return true if the access hit, false if it missed
+ *     Lets a cache hierarchy feed misses to its next level.
+ */
+static inline bool simulate_op_impl(cache_info info, cache c,
+                                    csim_stats_t *stats, const trace_op *op,
+                                    unsigned long long trace_num,
+                                    const csim_policy policy,
+                                    const unsigned long int assoc,
+                                    const csim_hash hash) {
+
+    unsigned long int s = info->s;
+    unsigned long int E = assoc != 0 ? assoc : info->E;
+    unsigned long int b = info->b;
+
+    unsigned long long set_index = (op->address & (~(~0ULL << s)) << b) >> b;
+    if (hash == HASH_XOR)
+        set_index ^= (op->address >> (s + b)) & (~(~0ULL << s));
+    unsigned long long tag_value = op->address >> (s + b);
+
+    // lines of the set occupy [base, base + E) in each field array
+    unsigned long long base = set_index * E;
+    unsigned long long *tag = &c->tag[base];
+    unsigned long long *order = &c->order[base];
+    bool *is_valid = &c->is_valid[base];
+    bool *has_data = &c->has_data[base];
+
+    if (assoc == 1) {
+        // direct-mapped: the one line either matches or gets replaced
+        bool dm_hit = (tag[0] == tag_value) & is_valid[0];
+        bool dm_empty = !is_valid[0];
+        if (dm_hit) {
+            if (op->store && !has_data[0]) {
+                stats->dirty_bytes += 1UL << b;
+                has_data[0] = true;
+            }
+            order[0] = trace_num;
+            stats->hits++;
+        } else {
+            stats->misses++;
+            if (!dm_empty) {
+                stats->evictions++;
+                if (has_data[0]) {
+                    stats->dirty_evictions += 1UL << b;
+                    stats->dirty_bytes -= 1UL << b;
+                }
+            }
+            tag[0] = tag_value;
+            is_valid[0] = true;
+            order[0] = trace_num;
+            has_data[0] = op->store;
+            if (op->store)
+                stats->dirty_bytes += 1UL << b;
+        }
+        if (logger.buf != NULL)
+            log_event(op, dm_hit, dm_empty);
+        return dm_hit;
+    }
+
+    bool hit;
+    bool empty = false;
+    unsigned long int mpt_line;
+
+    // looks for line with tag
+    unsigned long int hit_line = tag_search(tag, is_valid, E, tag_value, &hit);
+
+    if (hit) {
+        if (op->store && !has_data[hit_line]) {
+            stats->dirty_bytes += 1UL << b;
+            has_data[hit_line] = true;
+        }
+        if (policy == POLICY_LRU) {
+            order[hit_line] = trace_num;
+            if (c->lru_head != NULL)
+                lru_touch(c, E, set_index, (unsigned int)hit_line);
+        } else if (policy == POLICY_PLRU) {
+            plru_touch(c, E, set_index, hit_line);
+        } else if (policy == POLICY_SRRIP) {
+            c->rrpv[base + hit_line] = 0; // re-referenced: near future
+        }
+        stats->hits++;
+    } else { // then we have a miss
+        stats->misses++;
+
+        for (unsigned long int i = 0; !empty && i < E; i++) {
+            if (!is_valid[i])
+                empty = true;
+            if (empty)
+                mpt_line = i;
+        }
+
+        if (empty) {
+            tag[mpt_line] = tag_value;
+            is_valid[mpt_line] = true;
+            has_data[mpt_line] = false;
+            if (op->store && !has_data[mpt_line]) {
+                stats->dirty_bytes += 1UL << b;
+                has_data[mpt_line] = true;
+            }
+            if (policy == POLICY_LRU) {
+                order[mpt_line] = trace_num;
+                if (c->lru_head != NULL)
+                    lru_touch(c, E, set_index, (unsigned int)mpt_line);
+            } else if (policy == POLICY_PLRU) {
+                plru_touch(c, E, set_index, mpt_line);
+            } else if (policy == POLICY_SRRIP) {
+                c->rrpv[base + mpt_line] = 2; // inserted: long interval
+            }
+        } else {
+            stats->evictions++;
+
+            unsigned long int least_used;
+            if (policy == POLICY_PLRU) {
+                least_used = plru_victim(c, E, set_index);
+            } else if (policy == POLICY_RAND) {
+                unsigned long long x = c->rand_state;
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                c->rand_state = x;
+                least_used = x % E;
+            } else if (policy == POLICY_SRRIP) {
+                least_used = srrip_victim(&c->rrpv[base], E);
+            } else if (c->lru_head != NULL) { // O(1) victim from list tail
+                least_used = c->lru_tail[set_index];
+            } else {
+                least_used = 0;
+                for (unsigned long int i = 0; i < E; i++) {
+                    if (order[i] < order[least_used])
+                        least_used = i;
+                }
+            }
+
+            if (has_data[least_used]) {
+                stats->dirty_evictions += 1UL << b;
+                stats->dirty_bytes -= 1UL << b;
+            }
+
+            tag[least_used] = tag_value;
+            has_data[least_used] = false;
+            if (op->store && !has_data[least_used]) {
+                stats->dirty_bytes += 1UL << b;
+                has_data[least_used] = true;
+            }
+            if (policy == POLICY_LRU) {
+                order[least_used] = trace_num;
+                if (c->lru_head != NULL)
+                    lru_touch(c, E, set_index, (unsigned int)least_used);
+            } else if (policy == POLICY_PLRU) {
+                plru_touch(c, E, set_index, least_used);
+            } else if (policy == POLICY_SRRIP) {
+                c->rrpv[base + least_used] = 2;
+            }
+        }
+    }
+
+    if (logger.buf != NULL)
+        log_event(op, hit, empty);
+    return hit;
+}
+
+/**
+ * @brief Set of way within the skewed-associative index functions.
+ *     Multiplicative hash with a distinct odd multiplier per way; the
+ *     base constant is odd, so every multiplier stays odd and the map
+ *     is a bijection on blocks before the top bits are taken.
+ *
+ * @param[in] block : block number being mapped
+ * @param[in] way   : way whose index function to apply
+ * @param[in] s     : number of set index bits
+ *
+ * @return set index of block in the given way
+ */
+static inline unsigned long long skew_set(unsigned long long block,
+                                          unsigned long int way,
+                                          unsigned long int s) {
+    if (s == 0)
+        return 0;
+    return (block * (0x9E3779B97F4A7C15ULL + 2 * way)) >> (64 - s);
+}
+
+/**
+ * @brief Skewed-associative body of simulate_op (--hash skew).
+ *     Each way indexes its own row of the arena through a distinct
+ *     hash (see skew_set), so the E candidate lines of a block are
+ *     scattered instead of one contiguous set and conflict chains in
+ *     any single index function cannot pin a block down. Because the
+ *     candidates share no set, the contiguous tag scan, the per-set
+ *     LRU lists, and the non-LRU policy state do not apply; victims
+ *     come from an order-stamp scan over the E candidates, and lines
+ *     are keyed by full block number since the row no longer encodes
+ *     the low tag bits.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters updated by the operation
+ * @param[in] op        : decoded trace operation to perform
+ * @param[in] trace_num : position of operation within the trace
+ *
+ * @return true if the access hit, false if it missed
+ */
+static bool simulate_op_skew(cache_info info, cache c, csim_stats_t *stats,
+                             const trace_op *op,
+                             unsigned long long trace_num) {
+    unsigned long int s = info->s;
+    unsigned long int E = info->E;
+    unsigned long int b = info->b;
+    unsigned long long block = op->address >> b;
+
+    bool hit = false;
+    bool empty = false;
+    unsigned long long at = 0;
+
+    // probe the block's one candidate line per way
+    for (unsigned long int j = 0; j < E && !hit; j++) {
+        unsigned long long idx = skew_set(block, j, s) * E + j;
+        if (c->is_valid[idx] && c->tag[idx] == block) {
+            hit = true;
+            at = idx;
+        }
+    }
+
+    if (hit) {
+        if (op->store && !c->has_data[at]) {
+            stats->dirty_bytes += 1UL << b;
+            c->has_data[at] = true;
+        }
+        c->order[at] = trace_num;
+        stats->hits++;
+    } else {
+        stats->misses++;
+
+        // fill an invalid candidate if one exists, else the least
+        // recently used of the E candidates
+        at = skew_set(block, 0, s) * E;
+        for (unsigned long int j = 0; j < E; j++) {
+            unsigned long long idx = skew_set(block, j, s) * E + j;
+            if (!c->is_valid[idx]) {
+                empty = true;
+                at = idx;
+                break;
+            }
+            if (c->order[idx] < c->order[at])
+                at = idx;
+        }
+
+        if (!empty) {
+            stats->evictions++;
+            if (c->has_data[at]) {
+                stats->dirty_evictions += 1UL << b;
+                stats->dirty_bytes -= 1UL << b;
+            }
+        }
+
+        c->tag[at] = block;
+        c->is_valid[at] = true;
+        c->order[at] = trace_num;
+        c->has_data[at] = op->store;
+        if (op->store)
+            stats->dirty_bytes += 1UL << b;
+    }
+
+    if (logger.buf != NULL)
+        log_event(op, hit, empty);
+    return hit;
+}
+
+/**
+ * @brief Performs a single trace operation on the cache.
+ *     Dispatches once on the cache's index function and replacement
+ *     policy into the matching specialized kernel (see
+ *     simulate_op_impl); the default raw-bits kernels are untouched by
+ *     the hashed variants.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters updated by the operation
+ * @param[in] op        : decoded trace operation to perform
+ * @param[in] trace_num : position of operation within the trace
+ *
+ * @return true if the access hit, false if it missed
+ */
+static inline bool simulate_op_dispatch(cache_info info, cache c,
+                                        csim_stats_t *stats,
+                                        const trace_op *op,
+                                        unsigned long long trace_num) {
+    if (info->hash == HASH_SKEW)
+        return simulate_op_skew(info, c, stats, op, trace_num);
+    if (info->hash == HASH_XOR) {
+        switch (info->policy) {
+        case POLICY_PLRU:
+            return simulate_op_impl(info, c, stats, op, trace_num,
+                                    POLICY_PLRU, 0, HASH_XOR);
+        case POLICY_RAND:
+            return simulate_op_impl(info, c, stats, op, trace_num,
+                                    POLICY_RAND, 0, HASH_XOR);
+        case POLICY_SRRIP:
+            return simulate_op_impl(info, c, stats, op, trace_num,
+                                    POLICY_SRRIP, 0, HASH_XOR);
+        case POLICY_LRU:
+        default:
+            return simulate_op_impl(info, c, stats, op, trace_num, POLICY_LRU,
+                                    0, HASH_XOR);
+        }
+    }
+    switch (info->policy) {
+    case POLICY_PLRU:
+        return simulate_op_impl(info, c, stats, op, trace_num, POLICY_PLRU, 0,
+                                HASH_RAW);
+    case POLICY_RAND:
+        return simulate_op_impl(info, c, stats, op, trace_num, POLICY_RAND, 0,
+                                HASH_RAW);
+    case POLICY_SRRIP:
+        return simulate_op_impl(info, c, stats, op, trace_num, POLICY_SRRIP, 0,
+                                HASH_RAW);
+    case POLICY_LRU:
+    default:
+        // common associativities get loop-unrolled kernels
+        switch (info->E) {
+        case 1:
+            return simulate_op_impl(info, c, stats, op, trace_num, POLICY_LRU,
+                                    1, HASH_RAW);
+        case 2:
+            return simulate_op_impl(info, c, stats, op, trace_num, POLICY_LRU,
+                                    2, HASH_RAW);
+        case 4:
+            return simulate_op_impl(info, c, stats, op, trace_num, POLICY_LRU,
+                                    4, HASH_RAW);
+        case 8:
+            return simulate_op_impl(info, c, stats, op, trace_num, POLICY_LRU,
+                                    8, HASH_RAW);
+        default:
+            return simulate_op_impl(info, c, stats, op, trace_num, POLICY_LRU,
+                                    0, HASH_RAW);
+        }
+    }
+}
+
+/** @brief Prefetcher models selectable with --prefetch. */
+typedef enum {
+    PF_OFF = 0,  /* no prefetching (default) */
+    PF_NEXTLINE, /* fetch block B+1 on a miss to block B */
+    PF_STRIDE    /* stream table confirming per-region strides */
+} pf_mode;
+
+/** @brief Entries in the stride prefetcher's stream table. */
+#define PF_STREAMS 64
+
+/** @brief Log2 of blocks per stream-table region. */
+#define PF_REGION_BITS 6
+
+/**
+ * @brief One stream-table entry of the stride prefetcher.
+ *     Streams are keyed by address region rather than PC (traces carry
+ *     no PCs); a stride observed twice in a row within one region is
+ *     considered confirmed and prefetched ahead of.
+ *
+ * @arg region     : address region this entry tracks
+ * @arg last_block : block of the region's most recent miss
+ * @arg stride     : blocks between the last two misses
+ * @arg conf       : consecutive times the stride repeated
+ * @arg valid      : entry holds a live stream
+ */
+typedef struct {
+    unsigned long long region;
+    unsigned long long last_block;
+    long long stride;
+    unsigned int conf;
+    bool valid;
+} pf_stream;
+
+/**
+ * @brief Prefetcher state behind --prefetch.
+ *     The stream table is a fixed array and line_pf is one flag per
+ *     cache line allocated at setup, so nothing is allocated on the
+ *     per-operation path.
+ */
+static struct {
+    pf_mode mode;              /* selected model; PF_OFF disables all */
+    bool *line_pf;             /* line holds a not-yet-used prefetch */
+    unsigned long long issued; /* prefetch fills installed */
+    unsigned long long useful; /* demand hits on prefetched lines */
+    pf_stream table[PF_STREAMS];
+} pf;
+
+/**
+ * @brief Allocates the per-line prefetch flags and arms --prefetch.
+ *
+ * @param[in] info : struct containing cache info defined by user
+ * @param[in] mode : prefetcher model to run
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int pf_open(cache_info info, pf_mode mode) {
+    pf.line_pf = calloc(sizeof(bool), info->set_num * info->E);
+    if (pf.line_pf == NULL) {
+        fprintf(stderr, "Memory error when allocating prefetcher.");
+        return 1;
+    }
+    pf.mode = mode;
+    return 0;
+}
+
+/** @brief Releases prefetcher state; no-op unless --prefetch armed. */
+void pf_close(void) {
+    free(pf.line_pf);
+    pf.line_pf = NULL;
+    pf.mode = PF_OFF;
+}
+
+/**
+ * @brief Installs one predicted block into the cache.
+ *     Reuses the demand fill path of the policy kernels so victim
+ *     selection and dirty accounting stay exact, then takes back the
+ *     demand-miss count and hides the fill from the event log.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters (evictions stay real)
+ * @param[in] block     : block number to install
+ * @param[in] trace_num : position of the triggering operation
+ */
+void pf_install(cache_info info, cache c, csim_stats_t *stats,
+                unsigned long long block, unsigned long long trace_num) {
+    unsigned long long address = block << info->b;
+    unsigned long long set_index = hash_index(info, address);
+    unsigned long long tag_value = address >> (info->s + info->b);
+    unsigned long int E = info->E;
+
+    bool found = false;
+    tag_search(&c->tag[set_index * E], &c->is_valid[set_index * E], E,
+               tag_value, &found);
+    if (found)
+        return;
+
+    trace_op op = {address, 1, false};
+    char *saved_log = logger.buf; // prefetch fills are not demand events
+    logger.buf = NULL;
+    simulate_op_dispatch(info, c, stats, &op, trace_num);
+    logger.buf = saved_log;
+    stats->misses--;
+
+    unsigned long int way = tag_search(&c->tag[set_index * E],
+                                       &c->is_valid[set_index * E], E,
+                                       tag_value, &found);
+    if (found)
+        pf.line_pf[set_index * E + way] = true;
+    pf.issued++;
+}
+
+/**
+ * @brief Runs the prefetcher after one demand operation.
+ *     On a hit, credits the line if a prefetch brought it in. On a
+ *     miss, predicts the next block (next-line) or consults the stream
+ *     table (stride) and installs the prediction.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters updated by installs
+ * @param[in] op        : demand operation just simulated
+ * @param[in] trace_num : position of operation within the trace
+ * @param[in] hit       : whether the demand operation hit
+ */
+void pf_after_op(cache_info info, cache c, csim_stats_t *stats,
+                 const trace_op *op, unsigned long long trace_num, bool hit) {
+    unsigned long long block = op->address >> info->b;
+    unsigned long long set_index = hash_index(info, op->address);
+    unsigned long long tag_value = op->address >> (info->s + info->b);
+    unsigned long int E = info->E;
+
+    bool found = false;
+    unsigned long int way = tag_search(&c->tag[set_index * E],
+                                       &c->is_valid[set_index * E], E,
+                                       tag_value, &found);
+    if (found) {
+        unsigned long int idx = set_index * E + way;
+        if (hit && pf.line_pf[idx])
+            pf.useful++;
+        // demand touch: the line no longer counts as a pending prefetch
+        pf.line_pf[idx] = false;
+    }
+    if (hit)
+        return;
+
+    if (pf.mode == PF_NEXTLINE) {
+        pf_install(info, c, stats, block + 1, trace_num);
+        return;
+    }
+
+    unsigned long long region = block >> PF_REGION_BITS;
+    pf_stream *e = &pf.table[region % PF_STREAMS];
+    if (!e->valid || e->region != region) {
+        e->valid = true;
+        e->region = region;
+        e->last_block = block;
+        e->stride = 0;
+        e->conf = 0;
+        return;
+    }
+    long long stride = (long long)block - (long long)e->last_block;
+    if (stride != 0 && stride == e->stride) {
+        if (e->conf < 3)
+            e->conf++;
+    } else {
+        e->stride = stride;
+        e->conf = (stride != 0);
+    }
+    e->last_block = block;
+    if (e->conf >= 2)
+        pf_install(info, c, stats,
+                   (unsigned long long)((long long)block + e->stride),
+                   trace_num);
+}
+
+/** @brief Maximum entries of the victim buffer and store buffer. */
+#define VC_MAX_ENTRIES 64
+
+/**
+ * @brief Victim-buffer and store-buffer state behind --victim/--stbuf.
+ *     The victim buffer is a small fully associative cache between the
+ *     main array and memory: lines leaving the eviction branch park in
+ *     it, and misses probe it before going to memory; a probe hit
+ *     swaps the line back into the main array. The store buffer sits
+ *     behind it and absorbs retiring dirty lines, coalescing repeated
+ *     writebacks of one block into a single pending entry. The buffers
+ *     are fixed arrays; only the set-snapshot scratch (E entries, used
+ *     to identify the line the kernel replaced) is allocated at setup.
+ */
+static struct {
+    bool active;                /* armed by --victim or --stbuf */
+    unsigned long int entries;  /* victim-buffer entries (0 = none) */
+    unsigned long long block[VC_MAX_ENTRIES]; /* parked block numbers */
+    bool dirty[VC_MAX_ENTRIES];
+    bool valid[VC_MAX_ENTRIES];
+    unsigned long long order[VC_MAX_ENTRIES]; /* recency stamps */
+    unsigned long long swaps;   /* misses served out of the buffer */
+    unsigned long int sb_entries; /* store-buffer entries (0 = none) */
+    unsigned long long sb_block[VC_MAX_ENTRIES]; /* pending writebacks */
+    bool sb_valid[VC_MAX_ENTRIES];
+    unsigned long int sb_head;    /* oldest pending writeback (FIFO) */
+    unsigned long int sb_used;
+    unsigned long long coalesces; /* writebacks merged into pending */
+    unsigned long long *old_tag;  /* set snapshot scratch, E entries */
+    bool *old_valid;
+    bool *old_dirty;
+} vc;
+
+/**
+ * @brief Allocates the set-snapshot scratch and arms the buffers.
+ *
+ * @param[in] info       : struct containing cache info defined by user
+ * @param[in] entries    : victim-buffer entries (0 disables the probe)
+ * @param[in] sb_entries : store-buffer entries (0 disables coalescing)
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int vc_open(cache_info info, unsigned long int entries,
+            unsigned long int sb_entries) {
+    memset(&vc, 0, sizeof(vc));
+    vc.old_tag = malloc(sizeof(unsigned long long) * info->E);
+    vc.old_valid = malloc(sizeof(bool) * info->E);
+    vc.old_dirty = malloc(sizeof(bool) * info->E);
+    if (vc.old_tag == NULL || vc.old_valid == NULL || vc.old_dirty == NULL) {
+        fprintf(stderr, "Memory error when allocating victim buffer.");
+        free(vc.old_tag);
+        free(vc.old_valid);
+        free(vc.old_dirty);
+        return 1;
+    }
+    vc.entries = entries;
+    vc.sb_entries = sb_entries;
+    vc.active = true;
+    return 0;
+}
+
+/** @brief Releases buffer state; no-op unless the buffers are armed. */
+void vc_close(void) {
+    free(vc.old_tag);
+    free(vc.old_valid);
+    free(vc.old_dirty);
+    vc.old_tag = NULL;
+    vc.old_valid = NULL;
+    vc.old_dirty = NULL;
+    vc.active = false;
+}
+
+/**
+ * @brief Passes one retiring dirty line through the store buffer.
+ *     A block already pending coalesces into its entry; otherwise the
+ *     block takes a slot, pushing the oldest pending writeback out to
+ *     memory when the buffer is full.
+ *
+ * @param[in] block : block number of the retiring dirty line
+ */
+void vc_sb_retire(unsigned long long block) {
+    if (vc.sb_entries == 0)
+        return;
+    for (unsigned long int i = 0; i < vc.sb_entries; i++) {
+        if (vc.sb_valid[i] && vc.sb_block[i] == block) {
+            vc.coalesces++;
+            return;
+        }
+    }
+    unsigned long int slot = (vc.sb_head + vc.sb_used) % vc.sb_entries;
+    if (vc.sb_used == vc.sb_entries) // oldest writeback leaves to memory
+        vc.sb_head = (vc.sb_head + 1) % vc.sb_entries;
+    else
+        vc.sb_used++;
+    vc.sb_block[slot] = block;
+    vc.sb_valid[slot] = true;
+}
+
+/**
+ * @brief Parks one line evicted from the main array in the buffer.
+ *     Fills an invalid entry if one exists, else retires the least
+ *     recently parked line to memory: its writeback accounting happens
+ *     here, deferred from the eviction branch. With no victim entries
+ *     the line retires immediately.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] stats     : statistics counters updated by retirement
+ * @param[in] block     : block number of the evicted line
+ * @param[in] dirty     : whether the evicted line held dirty data
+ * @param[in] trace_num : position of operation within the trace
+ */
+void vc_park(cache_info info, csim_stats_t *stats, unsigned long long block,
+             bool dirty, unsigned long long trace_num) {
+    unsigned long int at = 0;
+    if (vc.entries > 0) {
+        for (unsigned long int i = 0; i < vc.entries; i++) {
+            if (!vc.valid[i]) {
+                at = i;
+                break;
+            }
+            if (vc.order[i] < vc.order[at])
+                at = i;
+        }
+        if (!vc.valid[at]) {
+            vc.block[at] = block;
+            vc.dirty[at] = dirty;
+            vc.valid[at] = true;
+            vc.order[at] = trace_num;
+            return;
+        }
+        // swap the retiring entry out and park the newcomer in it
+        unsigned long long out_block = vc.block[at];
+        bool out_dirty = vc.dirty[at];
+        vc.block[at] = block;
+        vc.dirty[at] = dirty;
+        vc.order[at] = trace_num;
+        block = out_block;
+        dirty = out_dirty;
+    }
+    if (dirty) {
+        stats->dirty_evictions += 1UL << info->b;
+        stats->dirty_bytes -= 1UL << info->b;
+        vc_sb_retire(block);
+    }
+}
+
+/**
+ * @brief Performs one operation with the buffers in the miss path.
+ *     Hits in the main array bypass the buffers entirely. On a would-
+ *     be miss the victim buffer is probed with a branchless fixed-size
+ *     scan, the set is snapshotted, and the kernel then runs its
+ *     normal miss path; afterwards the line the kernel replaced is
+ *     parked in the buffer (taking back the kernel's writeback
+ *     accounting, which now happens at buffer exit) and a probe hit is
+ *     converted from a miss into a hit -- a swap with the main array
+ *     rather than a trip to memory.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters updated by the operation
+ * @param[in] op        : decoded trace operation to perform
+ * @param[in] trace_num : position of operation within the trace
+ *
+ * @return true if the access hit, false if it missed
+ */
+bool vc_access(cache_info info, cache c, csim_stats_t *stats,
+               const trace_op *op, unsigned long long trace_num) {
+    unsigned long int s = info->s;
+    unsigned long int E = info->E;
+    unsigned long int b = info->b;
+    unsigned long long mask = ~(~0ULL << s);
+    unsigned long long set_index = hash_index(info, op->address);
+    unsigned long long base = set_index * E;
+    unsigned long long tag_value = op->address >> (s + b);
+
+    bool found = false;
+    tag_search(&c->tag[base], &c->is_valid[base], E, tag_value, &found);
+    if (found) // plain hit: no buffer traffic
+        return simulate_op_dispatch(info, c, stats, op, trace_num);
+
+    memcpy(vc.old_tag, &c->tag[base], sizeof(unsigned long long) * E);
+    memcpy(vc.old_valid, &c->is_valid[base], sizeof(bool) * E);
+    memcpy(vc.old_dirty, &c->has_data[base], sizeof(bool) * E);
+
+    // branchless probe: every entry is compared, a conditional move
+    // keeps the matching index
+    unsigned long long block = op->address >> b;
+    unsigned long int vat = vc.entries;
+    for (unsigned long int i = 0; i < vc.entries; i++)
+        vat = (vc.valid[i] & (vc.block[i] == block)) ? i : vat;
+    bool vhit = vat < vc.entries;
+    bool vdirty = vhit && vc.dirty[vat];
+    if (vhit) {
+        vc.valid[vat] = false;
+        if (vdirty) // its bytes leave the buffer with it
+            stats->dirty_bytes -= 1UL << b;
+    }
+
+    simulate_op_dispatch(info, c, stats, op, trace_num);
+
+    // the kernel installed the block; the way it landed in identifies
+    // the line it replaced
+    unsigned long int way = tag_search(&c->tag[base], &c->is_valid[base], E,
+                                       tag_value, &found);
+    if (vc.old_valid[way]) {
+        if (vc.old_dirty[way]) {
+            // the line parks in the buffer instead of retiring, so
+            // take the kernel's writeback accounting back for now
+            stats->dirty_evictions -= 1UL << b;
+            stats->dirty_bytes += 1UL << b;
+        }
+        unsigned long long idx_bits = set_index;
+        if (info->hash == HASH_XOR)
+            idx_bits ^= vc.old_tag[way] & mask;
+        vc_park(info, stats, (vc.old_tag[way] << s) | idx_bits,
+                vc.old_dirty[way], trace_num);
+    }
+
+    if (vhit) {
+        // served out of the victim buffer: a swap, not a memory miss
+        stats->misses--;
+        stats->hits++;
+        vc.swaps++;
+        if (vdirty && !c->has_data[base + way]) {
+            c->has_data[base + way] = true;
+            stats->dirty_bytes += 1UL << b;
+        }
+    }
+    return vhit;
+}
+
+/**
+ * @brief TLB state behind --tlb.
+ *     A set-associative translation buffer over virtual page numbers,
+ *     consulted once per operation page before the cache model runs,
+ *     with an optional second level probed on a first-level miss. Both
+ *     levels keep LRU order stamps like the low-associativity cache
+ *     kernels; the arrays are allocated once at setup.
+ */
+static struct {
+    bool active;
+    unsigned long int sets;       /* first-level sets */
+    unsigned long int assoc;      /* first-level ways per set */
+    unsigned long int page_bits;  /* log2 of the page size */
+    unsigned long long *vpn;      /* cached page numbers, sets * assoc */
+    bool *valid;
+    unsigned long long *order;    /* recency stamps */
+    unsigned long int l2_sets;    /* second-level sets (0 = one level) */
+    unsigned long int l2_assoc;
+    unsigned long long *l2_vpn;
+    bool *l2_valid;
+    unsigned long long *l2_order;
+    unsigned long long hits;      /* first-level hits */
+    unsigned long long l2_hits;   /* first-level misses caught by L2 */
+    unsigned long long misses;    /* full misses (page walks) */
+} tlb;
+
+/**
+ * @brief Parses a --tlb spec and allocates the translation buffer.
+ *     The spec is `entries:assoc:pagebits`, optionally extended with
+ *     `:entries:assoc` for a second level.
+ *
+ * @param[in] spec : TLB geometry specification string
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int tlb_open(const char *spec) {
+    unsigned long int entries = 0;
+    unsigned long int assoc = 0;
+    unsigned long int l2_entries = 0;
+    unsigned long int l2_assoc = 0;
+    memset(&tlb, 0, sizeof(tlb));
+
+    int got = sscanf(spec, "%lu:%lu:%lu:%lu:%lu", &entries, &assoc,
+                     &tlb.page_bits, &l2_entries, &l2_assoc);
+    if ((got != 3 && got != 5) || entries == 0 || assoc == 0 ||
+        entries % assoc != 0 || tlb.page_bits > 63 ||
+        (got == 5 &&
+         (l2_entries == 0 || l2_assoc == 0 || l2_entries % l2_assoc != 0))) {
+        fprintf(stderr, "Invalid option argument -- 'tlb'\n");
+        return 1;
+    }
+
+    tlb.sets = entries / assoc;
+    tlb.assoc = assoc;
+    tlb.vpn = calloc(sizeof(unsigned long long), entries);
+    tlb.valid = calloc(sizeof(bool), entries);
+    tlb.order = calloc(sizeof(unsigned long long), entries);
+    bool ok = tlb.vpn != NULL && tlb.valid != NULL && tlb.order != NULL;
+    if (ok && got == 5) {
+        tlb.l2_sets = l2_entries / l2_assoc;
+        tlb.l2_assoc = l2_assoc;
+        tlb.l2_vpn = calloc(sizeof(unsigned long long), l2_entries);
+        tlb.l2_valid = calloc(sizeof(bool), l2_entries);
+        tlb.l2_order = calloc(sizeof(unsigned long long), l2_entries);
+        ok = tlb.l2_vpn != NULL && tlb.l2_valid != NULL &&
+             tlb.l2_order != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory error when allocating TLB.");
+        return 1;
+    }
+    tlb.active = true;
+    return 0;
+}
+
+/** @brief Releases TLB state; no-op unless --tlb armed. */
+void tlb_close(void) {
+    free(tlb.vpn);
+    free(tlb.valid);
+    free(tlb.order);
+    free(tlb.l2_vpn);
+    free(tlb.l2_valid);
+    free(tlb.l2_order);
+    memset(&tlb, 0, sizeof(tlb));
+}
+
+/**
+ * @brief Installs a page into one TLB set, evicting its LRU entry.
+ *
+ * @param[in] vpn       : page-number array of the level
+ * @param[in] valid     : valid flags of the level
+ * @param[in] order     : recency stamps of the level
+ * @param[in] assoc     : ways per set of the level
+ * @param[in] page      : virtual page number to install
+ * @param[in] trace_num : position of operation within the trace
+ */
+void tlb_fill(unsigned long long *vpn, bool *valid, unsigned long long *order,
+              unsigned long int assoc, unsigned long long page,
+              unsigned long long trace_num) {
+    unsigned long int at = 0;
+    for (unsigned long int i = 0; i < assoc; i++) {
+        if (!valid[i]) {
+            at = i;
+            break;
+        }
+        if (order[i] < order[at])
+            at = i;
+    }
+    vpn[at] = page;
+    valid[at] = true;
+    order[at] = trace_num;
+}
+
+/**
+ * @brief Translates one page, walking on a full miss.
+ *     Probes the first level, then the second when configured; either
+ *     hit refreshes the entry's recency, and a full miss installs the
+ *     page into both levels.
+ *
+ * @param[in] page      : virtual page number to translate
+ * @param[in] trace_num : position of operation within the trace
+ */
+void tlb_lookup(unsigned long long page, unsigned long long trace_num) {
+    unsigned long long base = (page % tlb.sets) * tlb.assoc;
+    for (unsigned long int i = 0; i < tlb.assoc; i++) {
+        if (tlb.valid[base + i] && tlb.vpn[base + i] == page) {
+            tlb.order[base + i] = trace_num;
+            tlb.hits++;
+            return;
+        }
+    }
+    if (tlb.l2_sets > 0) {
+        unsigned long long l2 = (page % tlb.l2_sets) * tlb.l2_assoc;
+        for (unsigned long int i = 0; i < tlb.l2_assoc; i++) {
+            if (tlb.l2_valid[l2 + i] && tlb.l2_vpn[l2 + i] == page) {
+                tlb.l2_order[l2 + i] = trace_num;
+                tlb.l2_hits++;
+                tlb_fill(&tlb.vpn[base], &tlb.valid[base], &tlb.order[base],
+                         tlb.assoc, page, trace_num);
+                return;
+            }
+        }
+    }
+    tlb.misses++;
+    tlb_fill(&tlb.vpn[base], &tlb.valid[base], &tlb.order[base], tlb.assoc,
+             page, trace_num);
+    if (tlb.l2_sets > 0) {
+        unsigned long long l2 = (page % tlb.l2_sets) * tlb.l2_assoc;
+        tlb_fill(&tlb.l2_vpn[l2], &tlb.l2_valid[l2], &tlb.l2_order[l2],
+                 tlb.l2_assoc, page, trace_num);
+    }
+}
+
+/** @brief Search-depth histogram buckets kept by --profile. */
+#define PROF_DEPTH_MAX 64
+
+/**
+ * @brief Self-profiling counters (--profile).
+ *     Attributes rdtsc cycles to the phases of a run -- the simulation
+ *     kernel itself, TLB translation, the side bookkeeping after each
+ *     operation, trace parsing, cache allocation, and streaming I/O --
+ *     so a slow replay can be diagnosed without rerunning it under
+ *     perf. The counters are always compiled in; the gate on every hot
+ *     path is the single prof.active branch, which predicts perfectly
+ *     when the flag is off, so the instrumented binary is the
+ *     production binary. Cycle counts read as zero off x86-64.
+ *
+ * @arg active        : --profile given; counters are being kept
+ * @arg kernel_cycles : cycles inside the policy dispatch
+ * @arg tlb_cycles    : cycles translating pages (--tlb runs only)
+ * @arg side_cycles   : cycles in post-op bookkeeping (stats, prefetch)
+ * @arg parse_cycles  : cycles reading and parsing the trace up front
+ * @arg alloc_cycles  : cycles allocating the cache
+ * @arg io_cycles     : cycles fetching lines in the streaming engine
+ * @arg ops           : operations the kernel cycles cover
+ * @arg depth         : ways probed before a tag matched, per depth;
+ *                      the last bucket counts misses
+ */
+static struct {
+    bool active;
+    unsigned long long kernel_cycles;
+    unsigned long long tlb_cycles;
+    unsigned long long side_cycles;
+    unsigned long long parse_cycles;
+    unsigned long long alloc_cycles;
+    unsigned long long io_cycles;
+    unsigned long long ops;
+    unsigned long long depth[PROF_DEPTH_MAX + 1];
+} prof;
+
+/** @brief Reads the cycle counter; zero where rdtsc does not exist. */
+static inline unsigned long long prof_tick(void) {
+#ifdef __x86_64__
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Records the tag-search depth of one operation.
+ *     Probes the set before the kernel runs, so a miss has not yet
+ *     installed the tag the probe would then find. Depth is the way
+ *     at which the tag matched -- the length of the linear scan the
+ *     kernels perform -- and misses, which scan the whole set, land
+ *     in the last bucket.
+ *
+ * @param[in] info : struct containing cache info defined by user
+ * @param[in] c    : flat matrix representation of cache
+ * @param[in] op   : decoded trace operation about to be performed
+ */
+static inline void prof_depth_bump(cache_info info, cache c,
+                                   const trace_op *op) {
+    unsigned long long base = hash_index(info, op->address) * info->E;
+    unsigned long long tag = op->address >> (info->s + info->b);
+    for (unsigned long long way = 0; way < info->E; way++) {
+        if (c->is_valid[base + way] && c->tag[base + way] == tag) {
+            prof.depth[way < PROF_DEPTH_MAX ? way : PROF_DEPTH_MAX - 1]++;
+            return;
+        }
+    }
+    prof.depth[PROF_DEPTH_MAX]++;
+}
+
+/**
+ * @brief Cache side of simulate_op, after address translation.
+ *     Thin wrapper over the policy dispatch that applies the --sample
+ *     set filter and bumps the --stats counters when armed.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters updated by the operation
+ * @param[in] op        : decoded trace operation to perform
+ * @param[in] trace_num : position of operation within the trace
+ *
+ * @return true if the access hit, false if it missed
+ */
+static bool simulate_op_cache(cache_info info, cache c, csim_stats_t *stats,
+                              const trace_op *op,
+                              unsigned long long trace_num) {
+    // an access straddling block boundaries probes every block it
+    // touches; the expansion is inline, so the trace stays one node
+    // per operation no matter how many blocks an operation spans
+    unsigned long long last_block = (op->address + op->size - 1) >> info->b;
+    if (op->size != 0 && last_block != op->address >> info->b) {
+        unsigned long long end = op->address + op->size;
+        trace_op part = {op->address, 0, op->store};
+        bool hit = true;
+        for (unsigned long long blk = op->address >> info->b;
+             blk <= last_block; blk++) {
+            unsigned long long next = (blk + 1) << info->b;
+            part.size = (next < end ? next : end) - part.address;
+            hit = simulate_op_cache(info, c, stats, &part, trace_num) && hit;
+            part.address = next;
+        }
+        return hit;
+    }
+    if (info->sample > 1) {
+        // sampling mode: only 1 in sample sets ever touches the cache;
+        // the subset is picked by index hash so it is unbiased by layout
+        unsigned long long set_index = hash_index(info, op->address);
+        if (((set_index * 0x9E3779B97F4A7C15ULL) >> 32) % info->sample != 0)
+            return false;
+    }
+    if (!istats.active && pf.mode == PF_OFF && !vc.active && !prof.active)
+        return simulate_op_dispatch(info, c, stats, op, trace_num);
+    if (prof.active)
+        prof_depth_bump(info, c, op);
+    unsigned long long prev_evictions = stats->evictions;
+    unsigned long long p0 = prof.active ? prof_tick() : 0;
+    bool hit = vc.active ? vc_access(info, c, stats, op, trace_num)
+                         : simulate_op_dispatch(info, c, stats, op, trace_num);
+    unsigned long long p1 = prof.active ? prof_tick() : 0;
+    if (istats.active)
+        istats_bump(info, op, hit, stats->evictions != prev_evictions);
+    if (pf.mode != PF_OFF)
+        pf_after_op(info, c, stats, op, trace_num, hit);
+    if (prof.active) {
+        prof.kernel_cycles += p1 - p0;
+        prof.side_cycles += prof_tick() - p1;
+        prof.ops++;
+    }
+    return hit;
+}
+
+/**
+ * @brief Performs a single trace operation.
+ *     Translates every page the operation touches through the TLB
+ *     when --tlb is armed -- once per page, before the block-straddle
+ *     expansion splits the operation -- then runs the cache model.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] stats     : statistics counters updated by the operation
+ * @param[in] op        : decoded trace operation to perform
+ * @param[in] trace_num : position of operation within the trace
+ *
+ * @return true if the access hit, false if it missed
+ */
+bool simulate_op(cache_info info, cache c, csim_stats_t *stats,
+                 const trace_op *op, unsigned long long trace_num) {
+    if (tlb.active) {
+        unsigned long long t0 = prof.active ? prof_tick() : 0;
+        unsigned long long last_page =
+            (op->address + (op->size != 0 ? op->size - 1 : 0)) >>
+            tlb.page_bits;
+        for (unsigned long long page = op->address >> tlb.page_bits;
+             page <= last_page; page++)
+            tlb_lookup(page, trace_num);
+        if (prof.active)
+            prof.tlb_cycles += prof_tick() - t0;
+    }
+    return simulate_op_cache(info, c, stats, op, trace_num);
+}
+
+/**
+ * @brief Backing of the public csim_ctx handle (see csim.h).
+ *     Carries the running trace position so successive csim_push
+ *     batches stamp recency as one continuous trace.
+ *
+ * @arg info      : geometry the context was created with
+ * @arg c         : the context's cache
+ * @arg stats     : live counters, readable between pushes
+ * @arg trace_num : operations pushed since creation or reset
+ */
+struct csim_ctx_struct {
+    struct cache_info_struct info;
+    cache c;
+    csim_stats_t stats;
+    unsigned long long trace_num;
+};
+
+csim_ctx csim_create(unsigned long int s, unsigned long int E,
+                     unsigned long int b, csim_policy policy, int *result) {
+    if (E == 0 || s + b > 64 ||
+        (policy == POLICY_PLRU && (E > 64 || (E & (E - 1)) != 0))) {
+        *result = 1;
+        return NULL;
+    }
+
+    csim_ctx ctx = calloc(sizeof(struct csim_ctx_struct), 1);
+    if (ctx == NULL) {
+        *result = 2;
+        return NULL;
+    }
+    ctx->info.s = s;
+    ctx->info.E = E;
+    ctx->info.b = b;
+    ctx->info.set_num = 1UL << s;
+    ctx->info.policy = policy;
+    ctx->info.sample = 1;
+    ctx->info.hash = HASH_RAW;
+
+    int cache_result = 0;
+    ctx->c = make_cache(&ctx->info, &cache_result);
+    if (cache_result != 0) {
+        *result = 2;
+        if (ctx->c != NULL)
+            cache_free(ctx->c);
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void csim_push(csim_ctx ctx, const trace_op *ops, unsigned long int op_num) {
+    for (unsigned long int i = 0; i < op_num; i++) {
+        simulate_op(&ctx->info, ctx->c, &ctx->stats, &ops[i],
+                    ctx->trace_num);
+        ctx->trace_num++;
+    }
+}
+
+const csim_stats_t *csim_stats_read(csim_ctx ctx) {
+    return &ctx->stats;
+}
+
+void csim_reset(csim_ctx ctx) {
+    cache_reset(&ctx->info, ctx->c);
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->trace_num = 0;
+}
+
+void csim_free(csim_ctx ctx) {
+    cache_free(ctx->c);
+    free(ctx);
+}
+
+/** @brief Magic bytes opening a cache snapshot file ("CSIMSNP1"). */
+#define SNAP_MAGIC "CSIMSNP1"
+
+/**
+ * @brief Fixed-width header of a cache snapshot file.
+ *     A snapshot is this header followed by the cache arrays, each
+ *     written contiguously in a fixed order: tag, order, is_valid,
+ *     has_data, then whichever policy arrays the geometry implies
+ *     (LRU lists, plru bits, or rrpv). Fields are packed fixed-width
+ *     values in host byte order, so a snapshot can also be mmap'd and
+ *     read in place.
+ *
+ * @arg magic      : SNAP_MAGIC
+ * @arg s, E, b    : geometry the snapshot was taken with
+ * @arg policy     : replacement policy the snapshot was taken with
+ * @arg hash       : set-index function the snapshot was taken with
+ * @arg rand_state : xorshift victim state at the snapshot point
+ * @arg pos        : trace operations the snapshot covers (the offset
+ *     resume skips to; not derivable from the counters, since one
+ *     straddling operation can probe several blocks)
+ * @arg stats      : statistics counters at the snapshot point
+ */
+typedef struct {
+    char magic[TRACE_MAGIC_LEN];
+    unsigned long long s;
+    unsigned long long E;
+    unsigned long long b;
+    unsigned long long policy;
+    unsigned long long hash;
+    unsigned long long rand_state;
+    unsigned long long pos;
+    csim_stats_t stats;
+} snap_hdr;
+
+/**
+ * @brief Resume state armed by --resume.
+ *     Replay loops skip the first pos operations of the trace, and the
+ *     snapshot's counters are folded back into the final statistics.
+ */
+static struct {
+    unsigned long long pos;      /* trace operations the snapshot covers */
+    unsigned long long ops_done; /* trace operations replayed this run */
+    csim_stats_t stats;          /* counters at the snapshot point */
+    bool active;                 /* true when resuming */
+} snap = {0, 0, {0, 0, 0, 0, 0}, false};
+
+/**
+ * @brief Serializes the cache arrays and counters to a snapshot file.
+ *
+ * @param[in] info  : struct containing cache info defined by user
+ * @param[in] c     : flat matrix representation of cache
+ * @param[in] stats : statistics counters at the snapshot point
+ * @param[in] file  : path the snapshot is written to
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int snapshot_save(cache_info info, cache c, const csim_stats_t *stats,
+                  const char *file) {
+    FILE *out = fopen(file, "wb");
+    if (!out) {
+        fprintf(stderr, "Error opening '%s': %s\n", file, strerror(errno));
+        return 1;
+    }
+
+    unsigned long int line_num = info->set_num * info->E;
+    snap_hdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAP_MAGIC, TRACE_MAGIC_LEN);
+    hdr.s = info->s;
+    hdr.E = info->E;
+    hdr.b = info->b;
+    hdr.policy = info->policy;
+    hdr.hash = info->hash;
+    hdr.rand_state = c->rand_state;
+    hdr.pos = snap.ops_done;
+    hdr.stats = *stats;
+
+    bool ok =
+        fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+        fwrite(c->tag, sizeof(unsigned long long), line_num, out) ==
+            line_num &&
+        fwrite(c->order, sizeof(unsigned long long), line_num, out) ==
+            line_num &&
+        fwrite(c->is_valid, sizeof(bool), line_num, out) == line_num &&
+        fwrite(c->has_data, sizeof(bool), line_num, out) == line_num;
+    if (ok && c->lru_prev != NULL)
+        ok = fwrite(c->lru_prev, sizeof(unsigned int), line_num, out) ==
+                 line_num &&
+             fwrite(c->lru_next, sizeof(unsigned int), line_num, out) ==
+                 line_num &&
+             fwrite(c->lru_head, sizeof(unsigned int), info->set_num, out) ==
+                 info->set_num &&
+             fwrite(c->lru_tail, sizeof(unsigned int), info->set_num, out) ==
+                 info->set_num;
+    if (ok && info->policy == POLICY_PLRU)
+        ok = fwrite(c->plru, sizeof(unsigned long long), info->set_num,
+                    out) == info->set_num;
+    if (ok && info->policy == POLICY_SRRIP)
+        ok = fwrite(c->rrpv, sizeof(unsigned char), line_num, out) ==
+             line_num;
+
+    if (fclose(out) != 0)
+        ok = false;
+    if (!ok) {
+        fprintf(stderr, "Error writing snapshot -- %s\n", file);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Loads a snapshot into the cache and arms resume state.
+ *     The snapshot's geometry and policy must match the current run;
+ *     replay then skips the operations the snapshot already covers, so
+ *     experiments sharing a warmup phase pay for it only once.
+ *
+ * @param[in] info : struct containing cache info defined by user
+ * @param[in] c    : flat matrix representation of cache
+ * @param[in] file : path of the snapshot file
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int snapshot_load(cache_info info, cache c, const char *file) {
+    FILE *in = fopen(file, "rb");
+    if (!in) {
+        fprintf(stderr, "Error opening '%s': %s\n", file, strerror(errno));
+        return 1;
+    }
+
+    snap_hdr hdr;
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+        memcmp(hdr.magic, SNAP_MAGIC, TRACE_MAGIC_LEN) != 0) {
+        fprintf(stderr, "Not a csim snapshot -- %s\n", file);
+        fclose(in);
+        return 1;
+    }
+    if (hdr.s != info->s || hdr.E != info->E || hdr.b != info->b ||
+        hdr.policy != (unsigned long long)info->policy ||
+        hdr.hash != (unsigned long long)info->hash) {
+        fprintf(stderr, "Snapshot geometry does not match -- %s\n", file);
+        fclose(in);
+        return 1;
+    }
+
+    unsigned long int line_num = info->set_num * info->E;
+    bool ok =
+        fread(c->tag, sizeof(unsigned long long), line_num, in) == line_num &&
+        fread(c->order, sizeof(unsigned long long), line_num, in) ==
+            line_num &&
+        fread(c->is_valid, sizeof(bool), line_num, in) == line_num &&
+        fread(c->has_data, sizeof(bool), line_num, in) == line_num;
+    if (ok && c->lru_prev != NULL)
+        ok = fread(c->lru_prev, sizeof(unsigned int), line_num, in) ==
+                 line_num &&
+             fread(c->lru_next, sizeof(unsigned int), line_num, in) ==
+                 line_num &&
+             fread(c->lru_head, sizeof(unsigned int), info->set_num, in) ==
+                 info->set_num &&
+             fread(c->lru_tail, sizeof(unsigned int), info->set_num, in) ==
+                 info->set_num;
+    if (ok && info->policy == POLICY_PLRU)
+        ok = fread(c->plru, sizeof(unsigned long long), info->set_num, in) ==
+             info->set_num;
+    if (ok && info->policy == POLICY_SRRIP)
+        ok = fread(c->rrpv, sizeof(unsigned char), line_num, in) == line_num;
+
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "Error reading snapshot -- %s\n", file);
+        return 1;
+    }
+
+    c->rand_state = hdr.rand_state;
+    snap.stats = hdr.stats;
+    snap.pos = hdr.pos;
+    snap.active = true;
+    return 0;
+}
+
+/**
+ * @brief Re-stamps a resident line's recency after a batched run.
+ *     The batched single-block path (see simulator) performs only the
+ *     run's first operation; afterwards the line must look as if the
+ *     last repeat just touched it: a fresh order stamp, and a
+ *     near-future re-reference value under SRRIP. The PLRU bits and
+ *     LRU list position already face the line and repeated touches
+ *     are idempotent, so they need no patch.
+ *
+ * @param[in] info      : struct containing cache info defined by user
+ * @param[in] c         : flat matrix representation of cache
+ * @param[in] address   : address of the run's operations
+ * @param[in] trace_num : position of the run's last operation
+ */
+static void run_touch(cache_info info, cache c, unsigned long long address,
+                      unsigned long long trace_num) {
+    unsigned long long base = hash_index(info, address) * info->E;
+    unsigned long long tag_value = address >> (info->s + info->b);
+    bool found = false;
+    unsigned long int way = tag_search(&c->tag[base], &c->is_valid[base],
+                                       info->E, tag_value, &found);
+    if (!found)
+        return;
+    c->order[base + way] = trace_num;
+    if (info->policy == POLICY_SRRIP)
+        c->rrpv[base + way] = 0;
+}
+
+/**
+ * @brief Simulates cache behavior over a queue of trace operations.
+ *     Runs are expanded on the fly; a run confined to one cache block
+ *     skips the expansion entirely when no per-operation machinery is
+ *     armed, since every repeat after the first is by construction a
+ *     hit on the same line -- the first operation is performed, the
+ *     remaining count - 1 are folded into the hit counter in one step,
+ *     and the line's recency is re-stamped as of the run's end.
+ *
+ * @param[in] info   : struct containing cache info defined by user
+ * @param[in] trace  : queue of trace operations executed by function
+ * @param[in] c      : flat matrix representation of cache
+ * @param[in] result : value modified if errors
+ *     0 if no errors
+ *     2 if memory error
+ *
+ * @return NULL if memory allocation error
+ * @return struct of statistics from simulation
+ *     Counts of hits, misses, evictions, dirty bytes, dirty evictions
+ */
+csim_stats_t *simulator(cache_info info, traces trace, cache c, int *result) {
+    unsigned long long trace_num = 0;
+
+    csim_stats_t *ret_val = calloc(sizeof(csim_stats_t), 1);
+    if (ret_val == NULL) {
+        *result = 2;
+        return NULL;
+    }
+
+    // the batched path must not bypass anything counted or logged per
+    // operation, and re-stamping recency assumes a set row to probe
+    bool plain = logger.buf == NULL && !istats.active &&
+                 pf.mode == PF_OFF && !vc.active && !tlb.active &&
+                 info->sample == 1 && info->hash != HASH_SKEW;
+
+    traces curr = trace;
+    while (curr != NULL) {
+        trace_op op = {curr->address, curr->size, curr->store};
+
+        if (plain && curr->count > 1 && trace_num >= snap.pos) {
+            // a run stays in one block when its first and last touched
+            // bytes share the block number, whichever way it strides
+            unsigned long long last = curr->address +
+                (unsigned long long)((long long)(curr->count - 1) *
+                                     curr->stride);
+            unsigned long long lo = last < curr->address ? last
+                                                         : curr->address;
+            unsigned long long hi = last < curr->address ? curr->address
+                                                         : last;
+            hi += curr->size != 0 ? curr->size - 1 : 0;
+            if (lo >> info->b == hi >> info->b) {
+                simulate_op(info, c, ret_val, &op, trace_num);
+                ret_val->hits += curr->count - 1;
+                trace_num += curr->count;
+                run_touch(info, c, curr->address, trace_num - 1);
+                curr = curr->next;
+                continue;
+            }
+        }
+
+        for (unsigned long long i = 0; i < curr->count; i++) {
+            if (trace_num >= snap.pos) // skip ops a snapshot covers
+                simulate_op(info, c, ret_val, &op, trace_num);
+            op.address += (unsigned long long)curr->stride;
+            trace_num++;
+        }
+        curr = curr->next;
+    }
+    snap.ops_done = trace_num;
+    return ret_val;
+}
+
+/**
+ * @brief Simulates cache behavior while parsing the trace file.
+ *     Reads operations into a fixed-size batch and performs the batch
+ *     before reading the next one, so memory use stays constant no
+ *     matter how long the trace is, and simulation starts immediately
+ *     instead of after a full parse pass.
+ *
+ * @param[in] info       : struct containing cache info defined by user
+ * @param[in] trace_file : text path of trace file
+ * @param[in] c          : flat matrix representation of cache
+ * @param[in] result     : value modified if errors
+ *     0 if no errors
+ *     1 if trace format error
+ *     2 if memory error
+ *
+ * @return NULL if error before simulation could finish
+ * @return struct of statistics from simulation
+ */
+/** @brief Bytes per half of the streaming double buffer. */
+#define STREAM_BUF_BYTES (1UL << 20)
+
+/** @brief Alignment of the streaming buffers (page-sized). */
+#define STREAM_BUF_ALIGN 4096
+
+/**
+ * @brief Double-buffered trace reader shared with the I/O thread.
+ *     The I/O thread fills one large page-aligned buffer with raw
+ *     read() calls while the replay thread drains the other, so disk
+ *     and compute time overlap instead of adding. The condition pair
+ *     is the backpressure: the reader blocks when both buffers hold
+ *     unconsumed data, the consumer blocks when neither is ready.
+ *     cur/pos/active are the consumer's private drain cursor; the
+ *     shared flags are only touched under lock.
+ *
+ * @arg fd        : trace file descriptor
+ * @arg buf       : the two page-aligned fill targets
+ * @arg len       : bytes the reader filled into each buffer
+ * @arg ready     : buffer holds data the consumer has not drained
+ * @arg eof       : reader reached end of file
+ * @arg fail      : reader hit a read error
+ * @arg quit      : consumer is abandoning the file early
+ * @arg cur       : buffer the consumer is draining
+ * @arg pos       : consumer's offset within the current buffer
+ * @arg active    : consumer holds a buffer it has not released
+ * @arg lock      : guards the shared flags
+ * @arg can_fill  : signalled when a buffer is released for refilling
+ * @arg can_drain : signalled when a buffer is filled or the file ends
+ */
+typedef struct {
+    int fd;
+    char *buf[2];
+    size_t len[2];
+    bool ready[2];
+    bool eof;
+    bool fail;
+    bool quit;
+    unsigned long int cur;
+    size_t pos;
+    bool active;
+    pthread_mutex_t lock;
+    pthread_cond_t can_fill;
+    pthread_cond_t can_drain;
+} stream_reader;
+
+/**
+ * @brief I/O thread main: fills the double buffer ahead of replay.
+ *     Alternates between the two buffers, blocking while the next one
+ *     still holds unconsumed data. Each fill loops read() until the
+ *     buffer is full or the file ends, so a slow or network-attached
+ *     source still hands the consumer full buffers.
+ *
+ * @param[in] arg : the stream_reader
+ *
+ * @return NULL
+ */
+void *stream_reader_main(void *arg) {
+    stream_reader *r = arg;
+    unsigned long int k = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&r->lock);
+        while (r->ready[k] && !r->quit)
+            pthread_cond_wait(&r->can_fill, &r->lock);
+        bool quit = r->quit;
+        pthread_mutex_unlock(&r->lock);
+        if (quit)
+            return NULL;
+
+        size_t got = 0;
+        bool fail = false;
+        while (got < STREAM_BUF_BYTES) {
+            ssize_t n = read(r->fd, r->buf[k] + got, STREAM_BUF_BYTES - got);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                fail = true;
+                break;
+            }
+            if (n == 0)
+                break;
+            got += (size_t)n;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        if (fail) {
+            r->fail = true;
+        } else if (got == 0) {
+            r->eof = true;
+        } else {
+            r->len[k] = got;
+            r->ready[k] = true;
+        }
+        pthread_cond_signal(&r->can_drain);
+        pthread_mutex_unlock(&r->lock);
+        if (fail || got == 0)
+            return NULL;
+        k ^= 1;
+    }
+}
+
+/**
+ * @brief Copies the next trace line out of the double buffer.
+ *     Drains the current buffer byte by byte, releasing it back to
+ *     the I/O thread the moment it empties and stitching a line that
+ *     straddles the buffer boundary back together. A line longer than
+ *     the caller's buffer splits, as fgets would split it.
+ *
+ * @param[in] r       : the stream_reader
+ * @param[in] linebuf : line copied here, NUL terminated
+ * @param[in] cap     : capacity of linebuf
+ *
+ * @return 1  : a line was copied
+ * @return 0  : end of file
+ * @return -1 : read error
+ */
+int stream_read_line(stream_reader *r, char *linebuf, unsigned long int cap) {
+    unsigned long int out = 0;
+
+    for (;;) {
+        if (!r->active) {
+            pthread_mutex_lock(&r->lock);
+            while (!r->ready[r->cur] && !r->eof && !r->fail)
+                pthread_cond_wait(&r->can_drain, &r->lock);
+            bool have = r->ready[r->cur];
+            pthread_mutex_unlock(&r->lock);
+            if (!have) {
+                if (r->fail)
+                    return -1;
+                if (out == 0)
+                    return 0;
+                linebuf[out] = '\0'; // final line without a newline
+                return 1;
+            }
+            r->pos = 0;
+            r->active = true;
+        }
+
+        while (r->pos < r->len[r->cur] && out < cap - 1) {
+            char ch = r->buf[r->cur][r->pos++];
+            linebuf[out++] = ch;
+            if (ch == '\n') {
+                linebuf[out] = '\0';
+                return 1;
+            }
+        }
+        if (out == cap - 1) {
+            linebuf[out] = '\0';
+            return 1;
+        }
+
+        // buffer drained mid-line: hand it back for refilling and
+        // stitch the rest of the line from the next one
+        pthread_mutex_lock(&r->lock);
+        r->ready[r->cur] = false;
+        pthread_cond_signal(&r->can_fill);
+        pthread_mutex_unlock(&r->lock);
+        r->active = false;
+        r->cur ^= 1;
+    }
+}
+
+/**
+ * @brief Stops the I/O thread and releases the reader's resources.
+ *
+ * @param[in] r      : the stream_reader
+ * @param[in] reader : the I/O thread to join
+ */
+void stream_reader_close(stream_reader *r, pthread_t reader) {
+    pthread_mutex_lock(&r->lock);
+    r->quit = true;
+    r->ready[0] = false;
+    r->ready[1] = false;
+    pthread_cond_signal(&r->can_fill);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(reader, NULL);
+
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->can_fill);
+    pthread_cond_destroy(&r->can_drain);
+    free(r->buf[0]);
+    free(r->buf[1]);
+    close(r->fd);
+}
+
+csim_stats_t *simulator_stream(cache_info info, const char *trace_file,
+                               cache c, int *result) {
+    const int LINELEN = 40;
+
+    stream_reader r;
+    memset(&r, 0, sizeof(r));
+    r.fd = open(trace_file, O_RDONLY);
+    if (r.fd < 0) {
+        fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                strerror(errno));
+        *result = 1;
+        return NULL;
+    }
+    // page-aligned buffers: readahead-friendly, and an O_DIRECT fd
+    // could be dropped in without touching the fill path
+    r.buf[0] = aligned_alloc(STREAM_BUF_ALIGN, STREAM_BUF_BYTES);
+    r.buf[1] = aligned_alloc(STREAM_BUF_ALIGN, STREAM_BUF_BYTES);
+    csim_stats_t *ret_val = calloc(sizeof(csim_stats_t), 1);
+    trace_op *batch = malloc(sizeof(trace_op) * STREAM_BATCH);
+    if (r.buf[0] == NULL || r.buf[1] == NULL || ret_val == NULL ||
+        batch == NULL) {
+        free(r.buf[0]);
+        free(r.buf[1]);
+        free(ret_val);
+        free(batch);
+        close(r.fd);
+        *result = 2;
+        return NULL;
+    }
+    pthread_mutex_init(&r.lock, NULL);
+    pthread_cond_init(&r.can_fill, NULL);
+    pthread_cond_init(&r.can_drain, NULL);
+    pthread_t reader;
+    pthread_create(&reader, NULL, stream_reader_main, &r);
+
+    char linebuf[LINELEN];
+    unsigned long long trace_num = 0;
+    bool done = false;
+
+    while (!done) {
+        unsigned long int filled = 0;
+        while (filled < STREAM_BATCH) {
+            unsigned long long i0 = prof.active ? prof_tick() : 0;
+            int got = stream_read_line(&r, linebuf, LINELEN);
+            if (prof.active)
+                prof.io_cycles += prof_tick() - i0;
+            if (got <= 0) {
+                if (got < 0) {
+                    fprintf(stderr, "Error reading '%s': %s\n", trace_file,
+                            strerror(errno));
+                    stream_reader_close(&r, reader);
+                    free(batch);
+                    free(ret_val);
+                    *result = 1;
+                    return NULL;
+                }
+                done = true;
+                break;
+            }
+            if (parse_trace_line(linebuf, &batch[filled]) == 1) {
+                stream_reader_close(&r, reader);
+                free(batch);
+                free(ret_val);
+                *result = 1;
+                return NULL;
+            }
+            filled++;
+        }
+
+        for (unsigned long int i = 0; i < filled; i++) {
+            if (trace_num >= snap.pos) // skip ops a resumed snapshot covers
+                simulate_op(info, c, ret_val, &batch[i], trace_num);
+            trace_num++;
+        }
+    }
+
+    stream_reader_close(&r, reader);
+    free(batch);
+    snap.ops_done = trace_num;
+    return ret_val;
+}
+
+/**
+ * @brief Checks whether a trace file is in the binary format.
+ *     Binary traces (written by csim-convert) open with TRACE_MAGIC.
+ *
+ * @param[in] trace_file : path of trace file
+ *
+ * @return true if the file starts with the binary trace magic
+ */
+bool trace_is_binary(const char *trace_file) {
+    char magic[TRACE_MAGIC_LEN];
+    FILE *tfp = fopen(trace_file, "rb");
+    if (!tfp)
+        return false;
+    size_t got = fread(magic, 1, TRACE_MAGIC_LEN, tfp);
+    fclose(tfp);
+    return got == TRACE_MAGIC_LEN &&
+           memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) == 0;
+}
+
+/**
+ * @brief Simulates cache behavior over an mmap'd binary trace.
+ *     The file is mapped read-only and its fixed-width records are
+ *     iterated in place: no parsing, no copies, and no per-record
+ *     allocation. Replay cost is bounded by the simulation loop.
+ *
+ * @param[in] info       : struct containing cache info defined by user
+ * @param[in] trace_file : path of binary trace file (see tracefmt.h)
+ * @param[in] c          : flat matrix representation of cache
+ * @param[in] result     : value modified if errors
+ *     0 if no errors
+ *     1 if file error or malformed binary trace
+ *     2 if memory error
+ *
+ * @return NULL if error before simulation could finish
+ * @return struct of statistics from simulation
+ */
+csim_stats_t *simulator_mmap(cache_info info, const char *trace_file, cache c,
+                             int *result) {
+    int fd = open(trace_file, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                strerror(errno));
+        *result = 1;
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        ((size_t)st.st_size - TRACE_MAGIC_LEN) % sizeof(trace_rec) != 0) {
+        fprintf(stderr, "Malformed binary trace -- %s\n", trace_file);
+        close(fd);
+        *result = 1;
+        return NULL;
+    }
+    size_t rec_num = ((size_t)st.st_size - TRACE_MAGIC_LEN) / sizeof(trace_rec);
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        *result = 2;
+        return NULL;
+    }
+
+    csim_stats_t *ret_val = calloc(sizeof(csim_stats_t), 1);
+    if (ret_val == NULL) {
+        munmap(map, (size_t)st.st_size);
+        *result = 2;
+        return NULL;
+    }
+
+    const trace_rec *rec = (const trace_rec *)((const char *)map +
+                                               TRACE_MAGIC_LEN);
+    // binary records are fixed width, so a resumed snapshot lets replay
+    // jump straight to its trace offset
+    for (size_t i = snap.pos; i < rec_num; i++) {
+        trace_op op = {rec[i].address, rec[i].size, rec[i].store != 0};
+        simulate_op(info, c, ret_val, &op, i);
+    }
+
+    munmap(map, (size_t)st.st_size);
+    snap.ops_done = rec_num;
+    return ret_val;
+}
+
+/** @brief Number of operations per batch handed to a shard worker. */
+#define SHARD_BATCH 1024
+
+/** @brief Batches that may be queued per shard before backpressure. */
+#define SHARD_QUEUE 8
+
+/** @brief Maximum worker threads accepted by --threads. */
+#define SHARD_MAX_THREADS 256
+
+/**
+ * @brief A trace operation routed to a shard worker.
+ *     Carries the global trace position so order stamps stay
+ *     consistent with the single-threaded simulation.
+ *
+ * @arg op        : decoded trace operation
+ * @arg trace_num : position of operation within the trace
+ */
+typedef struct {
+    trace_op op;
+    unsigned long long trace_num;
+} shard_op;
+
+/**
+ * @brief State of one set-shard worker thread.
+ *     A worker owns every set with set_index % nthreads == shard id,
+ *     so no two workers ever touch the same lines of the shared cache
+ *     and the only synchronization is around the batch ring. The
+ *     producer fills batches and blocks when the ring is full; a
+ *     zero-length batch tells the worker to exit.
+ *
+ * @arg info      : cache info with verbose output suppressed
+ * @arg c         : shared flat cache; only this shard's sets accessed
+ * @arg stats     : statistics for this shard, merged after join
+ * @arg ring      : SHARD_QUEUE batches of SHARD_BATCH operations
+ * @arg ring_len  : number of valid operations per queued batch
+ * @arg head      : ring slot the worker pops next
+ * @arg tail      : ring slot the producer fills next
+ * @arg count     : batches currently queued
+ * @arg lock      : protects ring bookkeeping
+ * @arg not_empty : signaled when a batch is pushed
+ * @arg not_full  : signaled when a batch slot frees up
+ */
+typedef struct {
+    pthread_t thread;
+    struct cache_info_struct info;
+    cache c;
+    csim_stats_t stats;
+    shard_op *ring;
+    unsigned long int ring_len[SHARD_QUEUE];
+    unsigned long int head;
+    unsigned long int tail;
+    unsigned long int count;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} shard_worker;
+
+/**
+ * @brief Worker thread main loop: pops batches, simulates them.
+ *
+ * @param[in] arg : the worker's shard_worker state
+ *
+ * @return NULL always; results land in the worker's stats
+ */
+void *shard_main(void *arg) {
+    shard_worker *w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        while (w->count == 0)
+            pthread_cond_wait(&w->not_empty, &w->lock);
+        unsigned long int slot = w->head;
+        unsigned long int len = w->ring_len[slot];
+        pthread_mutex_unlock(&w->lock);
+
+        if (len == 0)
+            return NULL;
+
+        shard_op *batch = &w->ring[slot * SHARD_BATCH];
+        for (unsigned long int i = 0; i < len; i++)
+            simulate_op(&w->info, w->c, &w->stats, &batch[i].op,
+                        batch[i].trace_num);
+
+        pthread_mutex_lock(&w->lock);
+        w->head = (w->head + 1) % SHARD_QUEUE;
+        w->count--;
+        pthread_cond_signal(&w->not_full);
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+/**
+ * @brief Pushes a worker's pending batch into its ring.
+ *     Blocks while the ring is full, which is the backpressure that
+ *     keeps a slow shard from being buried in queued batches.
+ *
+ * @param[in] w   : worker to push to
+ * @param[in] len : operations in the pending batch (0 to stop worker)
+ */
+void shard_push(shard_worker *w, unsigned long int len) {
+    pthread_mutex_lock(&w->lock);
+    while (w->count == SHARD_QUEUE)
+        pthread_cond_wait(&w->not_full, &w->lock);
+    w->ring_len[w->tail] = len;
+    w->tail = (w->tail + 1) % SHARD_QUEUE;
+    w->count++;
+    pthread_cond_signal(&w->not_empty);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/**
+ * @brief Routes one decoded operation to its owning shard.
+ *     Appends to the shard's pending batch; when the batch is full it
+ *     is copied into the worker's ring in one handoff.
+ *
+ * @param[in] info        : struct containing cache info defined by user
+ * @param[in] workers     : shard worker array
+ * @param[in] pending     : per-shard batches being filled
+ * @param[in] pending_len : fill level of each pending batch
+ * @param[in] nthreads    : number of shard workers
+ * @param[in] op          : decoded trace operation to route
+ * @param[in] trace_num   : position of operation within the trace
+ */
+void shard_route(cache_info info, shard_worker *workers, shard_op *pending,
+                 unsigned long int *pending_len, unsigned long int nthreads,
+                 const trace_op *op, unsigned long long trace_num) {
+    // straddling accesses must split here, before sharding: each block
+    // can map to a set owned by a different worker
+    unsigned long long last_block = (op->address + op->size - 1) >> info->b;
+    if (op->size != 0 && last_block != op->address >> info->b) {
+        unsigned long long end = op->address + op->size;
+        trace_op part = {op->address, 0, op->store};
+        for (unsigned long long blk = op->address >> info->b;
+             blk <= last_block; blk++) {
+            unsigned long long next = (blk + 1) << info->b;
+            part.size = (next < end ? next : end) - part.address;
+            shard_route(info, workers, pending, pending_len, nthreads, &part,
+                        trace_num);
+            part.address = next;
+        }
+        return;
+    }
+    unsigned long long set_index = hash_index(info, op->address);
+    unsigned long int shard = set_index % nthreads;
+    shard_worker *w = &workers[shard];
+
+    shard_op *mine = &pending[shard * SHARD_BATCH];
+    mine[pending_len[shard]].op = *op;
+    mine[pending_len[shard]].trace_num = trace_num;
+    pending_len[shard]++;
+
+    if (pending_len[shard] == SHARD_BATCH) {
+        // wait for a free ring slot, then hand the whole batch over
+        pthread_mutex_lock(&w->lock);
+        while (w->count == SHARD_QUEUE)
+            pthread_cond_wait(&w->not_full, &w->lock);
+        unsigned long int slot = w->tail;
+        pthread_mutex_unlock(&w->lock);
+        memcpy(&w->ring[slot * SHARD_BATCH], mine,
+               sizeof(shard_op) * SHARD_BATCH);
+        shard_push(w, SHARD_BATCH);
+        pending_len[shard] = 0;
+    }
+}
+
+/**
+ * @brief Simulates cache behavior with set-sharded worker threads.
+ *     Sets are partitioned across nthreads workers by
+ *     set_index % nthreads; since an operation at one set index never
+ *     touches another set, shards proceed without locking the cache.
+ *     The producer thread decodes the trace, routes each operation to
+ *     its owning shard, and hands over batches rather than single
+ *     operations. Per-shard counters are merged after all workers
+ *     join. Verbose output is suppressed in this mode since shard
+ *     interleaving would scramble it.
+ *
+ * @param[in] info       : struct containing cache info defined by user
+ * @param[in] trace_file : path of trace file (text or binary)
+ * @param[in] c          : flat matrix representation of cache
+ * @param[in] nthreads   : number of shard workers to run
+ * @param[in] result     : value modified if errors
+ *     0 if no errors
+ *     1 if trace error
+ *     2 if memory or thread error
+ *
+ * @return NULL if error before simulation could finish
+ * @return struct of merged statistics from all shards
+ */
+csim_stats_t *simulator_threads(cache_info info, const char *trace_file,
+                                cache c, unsigned long int nthreads,
+                                int *result) {
+    const int LINELEN = 40;
+
+    shard_worker *workers = calloc(sizeof(shard_worker), nthreads);
+    if (workers == NULL) {
+        *result = 2;
+        return NULL;
+    }
+
+    // per-shard batch being filled by the producer
+    shard_op *pending = malloc(sizeof(shard_op) * SHARD_BATCH * nthreads);
+    unsigned long int *pending_len = calloc(sizeof(unsigned long int),
+                                            nthreads);
+    if (pending == NULL || pending_len == NULL) {
+        free(workers);
+        free(pending);
+        free(pending_len);
+        *result = 2;
+        return NULL;
+    }
+
+    for (unsigned long int k = 0; k < nthreads; k++) {
+        shard_worker *w = &workers[k];
+        w->info = *info;
+        w->info.v_flag = false;
+        w->c = c;
+        w->ring = malloc(sizeof(shard_op) * SHARD_BATCH * SHARD_QUEUE);
+        if (w->ring == NULL) {
+            for (unsigned long int j = 0; j < k; j++)
+                free(workers[j].ring);
+            free(workers);
+            free(pending);
+            free(pending_len);
+            *result = 2;
+            return NULL;
+        }
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_cond_init(&w->not_empty, NULL);
+        pthread_cond_init(&w->not_full, NULL);
+        pthread_create(&w->thread, NULL, shard_main, w);
+    }
+
+    // producer: decode the trace and route operations to their shards
+    int ret = 0;
+    unsigned long long trace_num = 0;
+    if (trace_is_binary(trace_file)) {
+        int fd = open(trace_file, O_RDONLY);
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fd >= 0 && fstat(fd, &st) == 0)
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                       0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                    strerror(errno));
+            ret = 1;
+        } else {
+            size_t rec_num =
+                ((size_t)st.st_size - TRACE_MAGIC_LEN) / sizeof(trace_rec);
+            const trace_rec *rec =
+                (const trace_rec *)((const char *)map + TRACE_MAGIC_LEN);
+            trace_num = snap.pos; // jump past a resumed snapshot's ops
+            for (size_t i = snap.pos; i < rec_num; i++) {
+                trace_op op = {rec[i].address, rec[i].size,
+                               rec[i].store != 0};
+                shard_route(info, workers, pending, pending_len, nthreads,
+                            &op, trace_num);
+                trace_num++;
+            }
+            munmap(map, (size_t)st.st_size);
+        }
+        if (fd >= 0)
+            close(fd);
+    } else {
+        FILE *tfp = fopen(trace_file, "rt");
+        if (!tfp) {
+            fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                    strerror(errno));
+            ret = 1;
+        } else {
+            char linebuf[LINELEN];
+            while (fgets(linebuf, LINELEN, tfp) != NULL) {
+                trace_op op;
+                if (parse_trace_line(linebuf, &op) == 1) {
+                    fprintf(stderr, "Error in trace file -- %s\n", trace_file);
+                    ret = 1;
+                    break;
+                }
+                if (trace_num < snap.pos) { // covered by a resumed snapshot
+                    trace_num++;
+                    continue;
+                }
+                shard_route(info, workers, pending, pending_len, nthreads,
+                            &op, trace_num);
+                trace_num++;
+            }
+            fclose(tfp);
+        }
+    }
+
+    snap.ops_done = trace_num;
+
+    // flush partial batches, then stop every worker
+    for (unsigned long int k = 0; k < nthreads; k++) {
+        shard_worker *w = &workers[k];
+        if (ret == 0 && pending_len[k] > 0) {
+            pthread_mutex_lock(&w->lock);
+            while (w->count == SHARD_QUEUE)
+                pthread_cond_wait(&w->not_full, &w->lock);
+            unsigned long int slot = w->tail;
+            pthread_mutex_unlock(&w->lock);
+            memcpy(&w->ring[slot * SHARD_BATCH], &pending[k * SHARD_BATCH],
+                   sizeof(shard_op) * pending_len[k]);
+            shard_push(w, pending_len[k]);
+        }
+        shard_push(w, 0);
+    }
+
+    csim_stats_t *ret_val = calloc(sizeof(csim_stats_t), 1);
+    for (unsigned long int k = 0; k < nthreads; k++) {
+        shard_worker *w = &workers[k];
+        pthread_join(w->thread, NULL);
+        if (ret_val != NULL) {
+            ret_val->hits += w->stats.hits;
+            ret_val->misses += w->stats.misses;
+            ret_val->evictions += w->stats.evictions;
+            ret_val->dirty_bytes += w->stats.dirty_bytes;
+            ret_val->dirty_evictions += w->stats.dirty_evictions;
+        }
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->not_empty);
+        pthread_cond_destroy(&w->not_full);
+        free(w->ring);
+    }
+    free(workers);
+    free(pending);
+    free(pending_len);
+
+    if (ret != 0) {
+        free(ret_val);
+        *result = ret;
+        return NULL;
+    }
+    if (ret_val == NULL) {
+        *result = 2;
+        return NULL;
+    }
+    return ret_val;
+}
+
+#ifndef CSIM_NO_MAIN
+
+// Everything below is the csim command line tool: the mode runners
+// (sweep, hierarchy, coherent, batch, compare) and main itself. They
+// print through the grading library's printSummary, which embedders
+// do not link, so a -DCSIM_NO_MAIN build ends at the engines above.
+
+/** @brief Names of the csim_policy values, indexed by the enum. */
+static const char *policy_names[] = {"lru", "plru", "rand", "srrip"};
+
+/** @brief Names of the csim_hash values, indexed by the enum. */
+static const char *hash_names[] = {"raw", "xor", "skew"};
+
+/**
+ * @brief Writes s to fp as a JSON string, escaping the specials.
+ *     Trace paths are the only free-form text in a result line;
+ *     quotes, backslashes, and control characters in them must not
+ *     break the framing.
+ *
+ * @param[in] fp : open results file
+ * @param[in] s  : string to embed
+ */
+void results_puts(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(fp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/**
+ * @brief Appends one machine-readable result line for one run.
+ *     One self-contained JSON object per line, holding the geometry,
+ *     the five counters, the replayed operation count and throughput,
+ *     and the --time model outputs when that flag is armed. Reporting
+ *     pipelines aggregate these with line-oriented tooling instead of
+ *     scraping the human summary. Results are a few hundred bytes per
+ *     run and the config inputs (--sweep, --batch) are already plain
+ *     text, so a packed binary record would buy nothing here.
+ *
+ * @param[in] results_file : file to append the line to
+ * @param[in] info         : cache basic information
+ * @param[in] trace_file   : name of trace file replayed
+ * @param[in] stats        : the run's final counters
+ * @param[in] ops          : trace operations the run replayed
+ * @param[in] seconds      : wall time the replay took
+ * @param[in] timed        : true when --time was armed
+ * @param[in] cycles       : --time cycle total (valid when timed)
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int results_append(const char *results_file, cache_info info,
+                   const char *trace_file, const csim_stats_t *stats,
+                   unsigned long long ops, double seconds, bool timed,
+                   unsigned long long cycles) {
+    FILE *fp = fopen(results_file, "at");
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening '%s': %s\n", results_file,
+                strerror(errno));
+        return 1;
+    }
+
+    fprintf(fp,
+            "{\"s\":%lu,\"E\":%lu,\"b\":%lu,\"policy\":\"%s\","
+            "\"hash\":\"%s\",\"trace\":",
+            info->s, info->E, info->b, policy_names[info->policy],
+            hash_names[info->hash]);
+    results_puts(fp, trace_file);
+    fprintf(fp,
+            ",\"hits\":%lu,\"misses\":%lu,"
+            "\"evictions\":%lu,\"dirty_bytes\":%lu,\"dirty_evictions\":%lu,"
+            "\"ops\":%llu,\"seconds\":%.6f,\"ops_per_sec\":%.0f",
+            stats->hits, stats->misses, stats->evictions, stats->dirty_bytes,
+            stats->dirty_evictions, ops, seconds,
+            seconds > 0 ? (double)ops / seconds : 0.0);
+    if (timed) {
+        unsigned long accesses = stats->hits + stats->misses;
+        fprintf(fp, ",\"cycles\":%llu,\"amat\":%.3f", cycles,
+                accesses > 0 ? (double)cycles / (double)accesses : 0.0);
+    }
+    fprintf(fp, "}\n");
+
+    fclose(fp);
+    return 0;
+}
+
+/** @brief Maximum number of configurations in one sweep. */
+#define SWEEP_MAX 4096
+
+/**
+ * @brief Replays one trace through many cache configurations at once.
+ *     The sweep file holds one `s,E,b` configuration per line. All
+ *     caches are allocated up front and every trace operation is fed
+ *     to each of them, so the trace is read and parsed exactly once
+ *     no matter how many configurations are swept. A summary is
+ *     printed per configuration, preceded by its geometry, and one
+ *     --results line is appended per configuration when that flag is
+ *     armed; the configurations replay interleaved in the one pass,
+ *     so each line carries the whole pass's wall time.
+ *
+ * @param[in] sweep_file   : text file of `s,E,b` lines, one per config
+ * @param[in] trace_file   : path of trace file (text or binary)
+ * @param[in] results_file : --results file, or NULL when not armed
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int run_sweep(const char *sweep_file, const char *trace_file,
+              const char *results_file) {
+    const int LINELEN = 40;
+
+    FILE *sfp = fopen(sweep_file, "rt");
+    if (!sfp) {
+        fprintf(stderr, "Error opening '%s': %s\n", sweep_file,
+                strerror(errno));
+        return 1;
+    }
+
+    struct cache_info_struct *infos =
+        calloc(sizeof(struct cache_info_struct), SWEEP_MAX);
+    if (infos == NULL) {
+        fclose(sfp);
+        fprintf(stderr, "Memory error when allocating sweep.");
+        return 1;
+    }
+
+    unsigned long int cfg_num = 0;
+    char linebuf[LINELEN];
+    while (fgets(linebuf, LINELEN, sfp) != NULL) {
+        if (linebuf[0] == '\n')
+            continue;
+        if (cfg_num == SWEEP_MAX) {
+            fprintf(stderr, "Too many sweep configurations (max %d)\n",
+                    SWEEP_MAX);
+            free(infos);
+            fclose(sfp);
+            return 1;
+        }
+
+        cache_info info = &infos[cfg_num];
+        char *tok = strtok(linebuf, ",");
+        errno = 0;
+        info->s = tok ? strtoul(tok, NULL, 0) : ULONG_MAX;
+        tok = strtok(NULL, ",");
+        info->E = tok ? strtoul(tok, NULL, 0) : 0;
+        tok = strtok(NULL, ",");
+        info->b = tok ? strtoul(tok, NULL, 0) : ULONG_MAX;
+
+        if (check_strtoul(info->s, "Invalid sweep line -- 's'") == 1 ||
+            check_strtoul(info->E, "Invalid sweep line -- 'E'") == 1 ||
+            check_strtoul(info->b, "Invalid sweep line -- 'b'") == 1 ||
+            info->E == 0 || info->s + info->b > 64) {
+            fprintf(stderr, "Error in sweep file -- %s\n", sweep_file);
+            free(infos);
+            fclose(sfp);
+            return 1;
+        }
+        info->set_num = 1UL << info->s;
+        info->v_flag = false; // verbose output is per-config noise in a sweep
+        info->stream_flag = false;
+        info->policy = POLICY_LRU;
+        info->sample = 1;
+        info->hash = HASH_RAW;
+        cfg_num++;
+    }
+    fclose(sfp);
+
+    if (cfg_num == 0) {
+        fprintf(stderr, "No configurations in sweep file -- %s\n", sweep_file);
+        free(infos);
+        return 1;
+    }
+
+    cache *caches = calloc(sizeof(cache), cfg_num);
+    csim_stats_t *stats = calloc(sizeof(csim_stats_t), cfg_num);
+    if (caches == NULL || stats == NULL) {
+        fprintf(stderr, "Memory error when allocating sweep.");
+        free(caches);
+        free(stats);
+        free(infos);
+        return 1;
+    }
+    for (unsigned long int k = 0; k < cfg_num; k++) {
+        int cache_result = 0;
+        caches[k] = make_cache(&infos[k], &cache_result);
+        if (cache_result != 0) {
+            fprintf(stderr, "Memory error when allocating cache.");
+            for (unsigned long int j = 0; j <= k; j++)
+                if (caches[j] != NULL)
+                    cache_free(caches[j]);
+            free(caches);
+            free(stats);
+            free(infos);
+            return 1;
+        }
+    }
+
+    // one pass over the trace, fanned out to every configuration
+    int ret = 0;
+    struct timespec rt0, rt1;
+    timespec_get(&rt0, TIME_UTC);
+    if (trace_is_binary(trace_file)) {
+        int fd = open(trace_file, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                    strerror(errno));
+            ret = 1;
+        } else {
+            size_t rec_num =
+                ((size_t)st.st_size - TRACE_MAGIC_LEN) / sizeof(trace_rec);
+            void *map =
+                mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                perror("mmap");
+                ret = 1;
+            } else {
+                const trace_rec *rec =
+                    (const trace_rec *)((const char *)map + TRACE_MAGIC_LEN);
+                for (size_t i = 0; i < rec_num; i++) {
+                    trace_op op = {rec[i].address, rec[i].size,
+                                   rec[i].store != 0};
+                    for (unsigned long int k = 0; k < cfg_num; k++)
+                        simulate_op(&infos[k], caches[k], &stats[k], &op, i);
+                }
+                munmap(map, (size_t)st.st_size);
+            }
+        }
+        if (fd >= 0)
+            close(fd);
+    } else {
+        FILE *tfp = fopen(trace_file, "rt");
+        if (!tfp) {
+            fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                    strerror(errno));
+            ret = 1;
+        } else {
+            unsigned long long trace_num = 0;
+            while (fgets(linebuf, LINELEN, tfp) != NULL) {
+                trace_op op;
+                if (parse_trace_line(linebuf, &op) == 1) {
+                    fprintf(stderr, "Error in trace file -- %s\n", trace_file);
+                    ret = 1;
+                    break;
+                }
+                for (unsigned long int k = 0; k < cfg_num; k++)
+                    simulate_op(&infos[k], caches[k], &stats[k], &op,
+                                trace_num);
+                trace_num++;
+            }
+            fclose(tfp);
+        }
+    }
+    timespec_get(&rt1, TIME_UTC);
+    if (ret == 1) {
+        for (unsigned long int k = 0; k < cfg_num; k++)
+            cache_free(caches[k]);
+        free(caches);
+        free(stats);
+        free(infos);
+        return 1;
+    }
+
+    double seconds = (double)(rt1.tv_sec - rt0.tv_sec) +
+                     (double)(rt1.tv_nsec - rt0.tv_nsec) / 1e9;
+    for (unsigned long int k = 0; k < cfg_num; k++) {
+        printf("config s=%lu E=%lu b=%lu\n", infos[k].s, infos[k].E,
+               infos[k].b);
+        printSummary(&stats[k]);
+        if (results_file != NULL &&
+            results_append(results_file, &infos[k], trace_file, &stats[k],
+                           stats[k].hits + stats[k].misses, seconds, false,
+                           0) == 1)
+            ret = 1;
+    }
+
+    for (unsigned long int k = 0; k < cfg_num; k++)
+        cache_free(caches[k]);
+    free(caches);
+    free(stats);
+    free(infos);
+    return ret;
+}
+
+/** @brief Maximum cache levels in a hierarchy. */
+#define HIERARCHY_MAX 4
+
+/**
+ * @brief Replays one trace through a multi-level cache hierarchy.
+ *     The spec string holds one `s:E:b` geometry per level, outermost
+ *     last, e.g. `5:8:6,8:8:6,13:16:6` for an L1/L2/L3 pipeline. Every
+ *     operation probes L1; a miss at level k is fed directly to level
+ *     k+1 in-process, so the whole hierarchy is simulated in a single
+ *     pass over the trace with no intermediate miss-stream files. The
+ *     levels are modeled as non-inclusive write-back caches, and a
+ *     summary is printed per level.
+ *
+ * @param[in] levels_spec : comma-separated `s:E:b` list, L1 first
+ * @param[in] trace_file  : path of trace file (text or binary)
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int run_hierarchy(char *levels_spec, const char *trace_file) {
+    const int LINELEN = 40;
+
+    struct cache_info_struct infos[HIERARCHY_MAX];
+    cache caches[HIERARCHY_MAX] = {NULL};
+    csim_stats_t stats[HIERARCHY_MAX];
+    memset(stats, 0, sizeof(stats));
+
+    // parse the level geometries out of the spec string
+    unsigned long int level_num = 0;
+    char *save_level;
+    char *level = strtok_r(levels_spec, ",", &save_level);
+    while (level != NULL) {
+        if (level_num == HIERARCHY_MAX) {
+            fprintf(stderr, "Too many cache levels (max %d)\n", HIERARCHY_MAX);
+            return 1;
+        }
+        cache_info info = &infos[level_num];
+
+        char *save_field;
+        char *tok = strtok_r(level, ":", &save_field);
+        errno = 0;
+        info->s = tok ? strtoul(tok, NULL, 0) : ULONG_MAX;
+        tok = strtok_r(NULL, ":", &save_field);
+        info->E = tok ? strtoul(tok, NULL, 0) : 0;
+        tok = strtok_r(NULL, ":", &save_field);
+        info->b = tok ? strtoul(tok, NULL, 0) : ULONG_MAX;
+
+        if (check_strtoul(info->s, "Invalid level spec -- 's'") == 1 ||
+            check_strtoul(info->E, "Invalid level spec -- 'E'") == 1 ||
+            check_strtoul(info->b, "Invalid level spec -- 'b'") == 1 ||
+            info->E == 0 || info->s + info->b > 64) {
+            fprintf(stderr, "Invalid --levels argument.\n");
+            return 1;
+        }
+        info->set_num = 1UL << info->s;
+        info->v_flag = false;
+        info->stream_flag = false;
+        info->policy = POLICY_LRU;
+        info->sample = 1;
+        info->hash = HASH_RAW;
+        level_num++;
+        level = strtok_r(NULL, ",", &save_level);
+    }
+    if (level_num == 0) {
+        fprintf(stderr, "Invalid --levels argument.\n");
+        return 1;
+    }
+
+    for (unsigned long int k = 0; k < level_num; k++) {
+        int cache_result = 0;
+        caches[k] = make_cache(&infos[k], &cache_result);
+        if (cache_result != 0) {
+            fprintf(stderr, "Memory error when allocating cache.");
+            for (unsigned long int j = 0; j <= k; j++)
+                if (caches[j] != NULL)
+                    cache_free(caches[j]);
+            return 1;
+        }
+    }
+
+    // one pass over the trace; misses trickle down the levels
+    int ret = 0;
+    if (trace_is_binary(trace_file)) {
+        int fd = open(trace_file, O_RDONLY);
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fd >= 0 && fstat(fd, &st) == 0)
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                       0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                    strerror(errno));
+            ret = 1;
+        } else {
+            size_t rec_num =
+                ((size_t)st.st_size - TRACE_MAGIC_LEN) / sizeof(trace_rec);
+            const trace_rec *rec =
+                (const trace_rec *)((const char *)map + TRACE_MAGIC_LEN);
+            for (size_t i = 0; i < rec_num; i++) {
+                trace_op op = {rec[i].address, rec[i].size,
+                               rec[i].store != 0};
+                for (unsigned long int k = 0; k < level_num; k++)
+                    if (simulate_op(&infos[k], caches[k], &stats[k], &op, i))
+                        break;
+            }
+            munmap(map, (size_t)st.st_size);
+        }
+        if (fd >= 0)
+            close(fd);
+    } else {
+        FILE *tfp = fopen(trace_file, "rt");
+        if (!tfp) {
+            fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                    strerror(errno));
+            ret = 1;
+        } else {
+            char linebuf[LINELEN];
+            unsigned long long trace_num = 0;
+            while (fgets(linebuf, LINELEN, tfp) != NULL) {
+                trace_op op;
+                if (parse_trace_line(linebuf, &op) == 1) {
+                    fprintf(stderr, "Error in trace file -- %s\n", trace_file);
+                    ret = 1;
+                    break;
+                }
+                for (unsigned long int k = 0; k < level_num; k++)
+                    if (simulate_op(&infos[k], caches[k], &stats[k], &op,
+                                    trace_num))
+                        break;
+                trace_num++;
+            }
+            fclose(tfp);
+        }
+    }
+
+    if (ret == 0) {
+        for (unsigned long int k = 0; k < level_num; k++) {
+            printf("L%lu s=%lu E=%lu b=%lu\n", k + 1, infos[k].s, infos[k].E,
+                   infos[k].b);
+            printSummary(&stats[k]);
+        }
+    }
+
+    for (unsigned long int k = 0; k < level_num; k++)
+        cache_free(caches[k]);
+    return ret;
+}
+
+/** @brief Maximum cores accepted in multi-core mode. */
+#define MESI_MAX_CORES 16
+
+/** @brief Coherence states of a private cache line. */
+typedef enum {
+    MESI_I = 0, /* invalid */
+    MESI_S,     /* shared: clean, other copies may exist */
+    MESI_E,     /* exclusive: clean, only copy */
+    MESI_M      /* modified: dirty, only copy */
+} mesi_state;
+
+typedef struct mesi_ctx_struct mesi_ctx;
+
+/**
+ * @brief One core's private cache and replay state.
+ *     The private cache is its own compact tag/state/order matrix
+ *     rather than a cache_struct because every line carries a MESI
+ *     state instead of valid/dirty bits. The lock guards the matrix
+ *     against snoops from other cores' bus transactions.
+ *
+ * @arg id            : core number (position of its -t option)
+ * @arg trace_file    : trace this core replays
+ * @arg ctx           : shared multi-core context
+ * @arg tag           : tag values (indexed set * E + way)
+ * @arg state         : MESI state per line
+ * @arg order         : recency of line usage (greater is more recent)
+ * @arg order_next    : this core's recency counter
+ * @arg hits          : private-cache hits
+ * @arg misses        : private-cache misses
+ * @arg coh_misses    : misses on blocks another core held at the time
+ * @arg invalidations : copies this core lost to other cores' stores
+ * @arg upgrades      : stores that promoted a shared copy (S to M)
+ * @arg result        : 1 if this core's replay failed
+ */
+typedef struct {
+    unsigned long int id;
+    const char *trace_file;
+    mesi_ctx *ctx;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    unsigned long long *tag;
+    unsigned char *state;
+    unsigned long long *order;
+    unsigned long long order_next;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long coh_misses;
+    unsigned long long invalidations;
+    unsigned long long upgrades;
+    int result;
+} mesi_core;
+
+/**
+ * @brief Shared state of a multi-core coherent simulation.
+ *     The bus lock serializes coherence transactions (misses, S-to-M
+ *     upgrades) and every shared-level access; private-cache hits
+ *     proceed under the owning core's lock only, so cores scale until
+ *     they actually contend for the bus.
+ *
+ * @arg l1          : private-cache geometry, common to all cores
+ * @arg shared_info : shared-level geometry
+ * @arg shared      : shared-level cache, guarded by bus
+ * @arg shared_stats: shared-level counters, guarded by bus
+ * @arg bus         : serializes coherence and shared-level traffic
+ * @arg bus_num     : shared-level access counter (its LRU stamps)
+ * @arg cores       : per-core private caches
+ * @arg core_num    : number of cores
+ */
+struct mesi_ctx_struct {
+    cache_info l1;
+    struct cache_info_struct shared_info;
+    cache shared;
+    csim_stats_t shared_stats;
+    pthread_mutex_t bus;
+    unsigned long long bus_num;
+    mesi_core cores[MESI_MAX_CORES];
+    unsigned long int core_num;
+};
+
+/**
+ * @brief Scans one private set for a line holding the given tag.
+ *
+ * @param[in] w         : core whose cache is scanned (lock held)
+ * @param[in] base      : first line of the set (set_index * E)
+ * @param[in] tag_value : tag to search for
+ * @param[in] found     : set true if a non-invalid matching line exists
+ *
+ * @return way of the matching line; meaningless if *found is false
+ */
+unsigned long int mesi_search(mesi_core *w, unsigned long int base,
+                              unsigned long long tag_value, bool *found) {
+    unsigned long int E = w->ctx->l1->E;
+    for (unsigned long int j = 0; j < E; j++) {
+        if (w->state[base + j] != MESI_I && w->tag[base + j] == tag_value) {
+            *found = true;
+            return j;
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+/**
+ * @brief Accesses the shared level on behalf of a core.
+ *     Caller holds the bus lock; the access is stamped with the
+ *     bus-global counter so the shared LRU sees one interleaved
+ *     stream, exactly like a shared cache on real hardware.
+ *
+ * @param[in] x       : shared multi-core context
+ * @param[in] address : address to access
+ * @param[in] store   : true for a writeback, false for a fetch
+ */
+void mesi_shared_access(mesi_ctx *x, unsigned long long address, bool store) {
+    trace_op op = {address, 1, store};
+    simulate_op(&x->shared_info, x->shared, &x->shared_stats, &op,
+                x->bus_num++);
+}
+
+/**
+ * @brief Performs one trace operation against a core's private cache.
+ *     Loads and stores that hit in M or E complete under the core's
+ *     own lock. Anything needing the bus -- a miss or an S-to-M
+ *     upgrade -- retakes the core lock under the bus lock, re-checks
+ *     the set (a snoop may have run in between), snoops the other
+ *     cores, and goes to the shared level for fetches and writebacks.
+ *
+ * @param[in] w  : core performing the operation
+ * @param[in] op : decoded trace operation
+ */
+void mesi_access(mesi_core *w, const trace_op *op) {
+    mesi_ctx *x = w->ctx;
+    cache_info info = x->l1;
+    // straddling accesses probe every private-cache block they touch
+    unsigned long long last_block = (op->address + op->size - 1) >> info->b;
+    if (op->size != 0 && last_block != op->address >> info->b) {
+        unsigned long long end = op->address + op->size;
+        trace_op part = {op->address, 0, op->store};
+        for (unsigned long long blk = op->address >> info->b;
+             blk <= last_block; blk++) {
+            unsigned long long next = (blk + 1) << info->b;
+            part.size = (next < end ? next : end) - part.address;
+            mesi_access(w, &part);
+            part.address = next;
+        }
+        return;
+    }
+    unsigned long int E = info->E;
+    unsigned long long set_index =
+        (op->address >> info->b) & (~(~0ULL << info->s));
+    unsigned long long tag_value = op->address >> (info->s + info->b);
+    unsigned long int base = set_index * E;
+
+    // fast path: a hit that needs no bus transaction
+    bool found = false;
+    pthread_mutex_lock(&w->lock);
+    unsigned long int way = mesi_search(w, base, tag_value, &found);
+    if (found) {
+        unsigned char state = w->state[base + way];
+        if (!op->store || state == MESI_M || state == MESI_E) {
+            if (op->store)
+                w->state[base + way] = MESI_M;
+            w->order[base + way] = w->order_next++;
+            w->hits++;
+            pthread_mutex_unlock(&w->lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    // slow path: bus transaction (miss, or store needing an upgrade)
+    pthread_mutex_lock(&x->bus);
+    pthread_mutex_lock(&w->lock);
+    way = mesi_search(w, base, tag_value, &found);
+    if (found && (!op->store || w->state[base + way] != MESI_S)) {
+        // a snoop resolved it while we waited for the bus
+        unsigned char state = w->state[base + way];
+        if (!op->store || state == MESI_M || state == MESI_E) {
+            if (op->store)
+                w->state[base + way] = MESI_M;
+            w->order[base + way] = w->order_next++;
+            w->hits++;
+            pthread_mutex_unlock(&w->lock);
+            pthread_mutex_unlock(&x->bus);
+            return;
+        }
+    }
+
+    // snoop every other core; stores take all copies, loads demote them
+    bool others_held = false;
+    for (unsigned long int k = 0; k < x->core_num; k++) {
+        mesi_core *peer = &x->cores[k];
+        if (peer == w)
+            continue;
+        bool pfound = false;
+        pthread_mutex_lock(&peer->lock);
+        unsigned long int pway = mesi_search(peer, base, tag_value, &pfound);
+        if (pfound) {
+            others_held = true;
+            if (peer->state[base + pway] == MESI_M)
+                mesi_shared_access(x, op->address, true); // writeback
+            if (op->store) {
+                peer->state[base + pway] = MESI_I;
+                peer->invalidations++;
+            } else {
+                peer->state[base + pway] = MESI_S;
+            }
+        }
+        pthread_mutex_unlock(&peer->lock);
+    }
+
+    if (found && op->store) {
+        // upgrade: our shared copy becomes the only, modified one
+        w->state[base + way] = MESI_M;
+        w->order[base + way] = w->order_next++;
+        w->hits++;
+        w->upgrades++;
+        pthread_mutex_unlock(&w->lock);
+        pthread_mutex_unlock(&x->bus);
+        return;
+    }
+
+    // true miss: fetch from the shared level and install
+    w->misses++;
+    if (others_held)
+        w->coh_misses++;
+    mesi_shared_access(x, op->address, false);
+
+    unsigned long int victim = 0;
+    unsigned long long oldest = ULLONG_MAX;
+    for (unsigned long int j = 0; j < E; j++) {
+        if (w->state[base + j] == MESI_I) {
+            victim = j;
+            break;
+        }
+        if (w->order[base + j] < oldest) {
+            oldest = w->order[base + j];
+            victim = j;
+        }
+    }
+    if (w->state[base + victim] == MESI_M) {
+        // evicted dirty line goes back to the shared level
+        unsigned long long wb_address =
+            (w->tag[base + victim] << (info->s + info->b)) |
+            (set_index << info->b);
+        mesi_shared_access(x, wb_address, true);
+    }
+    w->tag[base + victim] = tag_value;
+    w->state[base + victim] =
+        op->store ? MESI_M : (others_held ? MESI_S : MESI_E);
+    w->order[base + victim] = w->order_next++;
+    pthread_mutex_unlock(&w->lock);
+    pthread_mutex_unlock(&x->bus);
+}
+
+/**
+ * @brief Replays one core's trace through its private cache.
+ *     Thread entry point; mirrors the text/binary replay of the other
+ *     simulator modes and records failure in the core's result.
+ *
+ * @param[in] arg : the mesi_core to run
+ *
+ * @return NULL always; outcome is in the core's result field
+ */
+void *mesi_core_main(void *arg) {
+    const int LINELEN = 40;
+    mesi_core *w = arg;
+
+    if (trace_is_binary(w->trace_file)) {
+        int fd = open(w->trace_file, O_RDONLY);
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fd >= 0 && fstat(fd, &st) == 0)
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                       0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Error opening '%s': %s\n", w->trace_file,
+                    strerror(errno));
+            w->result = 1;
+        } else {
+            size_t rec_num =
+                ((size_t)st.st_size - TRACE_MAGIC_LEN) / sizeof(trace_rec);
+            const trace_rec *rec =
+                (const trace_rec *)((const char *)map + TRACE_MAGIC_LEN);
+            for (size_t i = 0; i < rec_num; i++) {
+                trace_op op = {rec[i].address, rec[i].size,
+                               rec[i].store != 0};
+                mesi_access(w, &op);
+            }
+            munmap(map, (size_t)st.st_size);
+        }
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    FILE *tfp = fopen(w->trace_file, "rt");
+    if (!tfp) {
+        fprintf(stderr, "Error opening '%s': %s\n", w->trace_file,
+                strerror(errno));
+        w->result = 1;
+        return NULL;
+    }
+    char linebuf[LINELEN];
+    while (fgets(linebuf, LINELEN, tfp) != NULL) {
+        trace_op op;
+        if (parse_trace_line(linebuf, &op) == 1) {
+            fprintf(stderr, "Error in trace file -- %s\n", w->trace_file);
+            w->result = 1;
+            break;
+        }
+        mesi_access(w, &op);
+    }
+    fclose(tfp);
+    return NULL;
+}
+
+/**
+ * @brief Runs a multi-core coherent simulation.
+ *     One thread per core replays that core's trace through a private
+ *     MESI cache of the -s/-E/-b geometry; misses, writebacks, and
+ *     coherence traffic meet at a shared level whose `s:E:b` geometry
+ *     comes from the --shared spec. Per-core counters and the shared
+ *     summary are printed at the end. Because cores run concurrently,
+ *     the shared-level interleaving -- like real contention -- varies
+ *     run to run.
+ *
+ * @param[in] info        : private-cache geometry (set_num filled in)
+ * @param[in] shared_spec : `s:E:b` geometry of the shared level
+ * @param[in] trace_files : one trace path per core
+ * @param[in] core_num    : number of cores
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int run_mesi(cache_info info, char *shared_spec, char **trace_files,
+             unsigned long int core_num) {
+    mesi_ctx *x = calloc(sizeof(mesi_ctx), 1);
+    if (x == NULL) {
+        fprintf(stderr, "Memory error when allocating cores.");
+        return 1;
+    }
+    x->l1 = info;
+    x->core_num = core_num;
+
+    // parse the shared level's geometry out of the spec string
+    cache_info sh = &x->shared_info;
+    char *save_field;
+    char *tok = strtok_r(shared_spec, ":", &save_field);
+    errno = 0;
+    sh->s = tok ? strtoul(tok, NULL, 0) : ULONG_MAX;
+    tok = strtok_r(NULL, ":", &save_field);
+    sh->E = tok ? strtoul(tok, NULL, 0) : 0;
+    tok = strtok_r(NULL, ":", &save_field);
+    sh->b = tok ? strtoul(tok, NULL, 0) : ULONG_MAX;
+    if (check_strtoul(sh->s, "Invalid shared spec -- 's'") == 1 ||
+        check_strtoul(sh->E, "Invalid shared spec -- 'E'") == 1 ||
+        check_strtoul(sh->b, "Invalid shared spec -- 'b'") == 1 ||
+        sh->E == 0 || sh->s + sh->b > 64) {
+        fprintf(stderr, "Invalid --shared argument.\n");
+        free(x);
+        return 1;
+    }
+    sh->set_num = 1UL << sh->s;
+    sh->v_flag = false;
+    sh->stream_flag = false;
+    sh->policy = POLICY_LRU;
+    sh->sample = 1;
+    sh->hash = HASH_RAW;
+
+    int cache_result = 0;
+    x->shared = make_cache(sh, &cache_result);
+    if (cache_result != 0) {
+        fprintf(stderr, "Memory error when allocating cache.");
+        if (x->shared != NULL)
+            cache_free(x->shared);
+        free(x);
+        return 1;
+    }
+    pthread_mutex_init(&x->bus, NULL);
+
+    unsigned long int line_num = info->set_num * info->E;
+    int ret = 0;
+    for (unsigned long int k = 0; k < core_num; k++) {
+        mesi_core *w = &x->cores[k];
+        w->id = k;
+        w->trace_file = trace_files[k];
+        w->ctx = x;
+        w->tag = calloc(sizeof(unsigned long long), line_num);
+        w->state = calloc(sizeof(unsigned char), line_num);
+        w->order = calloc(sizeof(unsigned long long), line_num);
+        if (w->tag == NULL || w->state == NULL || w->order == NULL) {
+            fprintf(stderr, "Memory error when allocating cache.");
+            ret = 1;
+            core_num = k + 1; // free what exists, run nothing
+            break;
+        }
+        pthread_mutex_init(&w->lock, NULL);
+    }
+
+    if (ret == 0) {
+        for (unsigned long int k = 0; k < core_num; k++)
+            pthread_create(&x->cores[k].thread, NULL, mesi_core_main,
+                           &x->cores[k]);
+        for (unsigned long int k = 0; k < core_num; k++) {
+            pthread_join(x->cores[k].thread, NULL);
+            if (x->cores[k].result != 0)
+                ret = 1;
+        }
+    }
+
+    if (ret == 0) {
+        for (unsigned long int k = 0; k < core_num; k++) {
+            mesi_core *w = &x->cores[k];
+            printf("core %lu: hits:%llu misses:%llu coherence_misses:%llu "
+                   "invalidations:%llu upgrades:%llu\n",
+                   k, w->hits, w->misses, w->coh_misses, w->invalidations,
+                   w->upgrades);
+        }
+        printf("shared s=%lu E=%lu b=%lu\n", sh->s, sh->E, sh->b);
+        printSummary(&x->shared_stats);
+    }
+
+    for (unsigned long int k = 0; k < core_num; k++) {
+        free(x->cores[k].tag);
+        free(x->cores[k].state);
+        free(x->cores[k].order);
+    }
+    cache_free(x->shared);
+    free(x);
+    return ret;
+}
+
+/** @brief Maximum length of one batch manifest line. */
+#define BATCH_LINELEN 512
+
+/**
+ * @brief One simulation job of a batch manifest.
+ *
+ * @arg info       : geometry parsed from the manifest line
+ * @arg trace_file : trace this job replays
+ * @arg stats      : the job's counters, filled by its worker
+ * @arg seconds    : wall time the job's replay took
+ * @arg result     : 0 ok, 1 trace error, 2 memory error
+ */
+typedef struct {
+    struct cache_info_struct info;
+    char *trace_file;
+    csim_stats_t stats;
+    double seconds;
+    int result;
+} batch_job;
+
+/**
+ * @brief Shared queue of a batch run.
+ *     Jobs are independent, so stealing reduces to idle workers
+ *     claiming the next unclaimed index; fast workers naturally take
+ *     more jobs and the pool stays saturated until the list is empty.
+ *
+ * @arg jobs    : all jobs of the manifest, in file order
+ * @arg job_num : number of jobs
+ * @arg next    : next unclaimed job, guarded by lock
+ * @arg lock    : guards next
+ */
+typedef struct {
+    batch_job *jobs;
+    unsigned long int job_num;
+    unsigned long int next;
+    pthread_mutex_t lock;
+} batch_pool;
+
+/**
+ * @brief Replays one job's trace into an already-allocated cache.
+ *     Text traces are parsed line by line; binary traces are mmap'd.
+ *     Only per-worker state is touched, so jobs replay concurrently.
+ *
+ * @param[in] info       : geometry of the job
+ * @param[in] c          : cache to replay into (already reset)
+ * @param[in] stats      : counters filled by the replay
+ * @param[in] trace_file : path of trace file (text or binary)
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int batch_replay(cache_info info, cache c, csim_stats_t *stats,
+                 const char *trace_file) {
+    const int LINELEN = 40;
+
+    if (trace_is_binary(trace_file)) {
+        int fd = open(trace_file, O_RDONLY);
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fd >= 0 && fstat(fd, &st) == 0)
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                       0);
+        if (fd >= 0)
+            close(fd);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                    strerror(errno));
+            return 1;
+        }
+        size_t rec_num =
+            ((size_t)st.st_size - TRACE_MAGIC_LEN) / sizeof(trace_rec);
+        const trace_rec *rec =
+            (const trace_rec *)((const char *)map + TRACE_MAGIC_LEN);
+        for (size_t i = 0; i < rec_num; i++) {
+            trace_op op = {rec[i].address, rec[i].size, rec[i].store != 0};
+            simulate_op(info, c, stats, &op, i);
+        }
+        munmap(map, (size_t)st.st_size);
+        return 0;
+    }
+
+    FILE *tfp = fopen(trace_file, "rt");
+    if (!tfp) {
+        fprintf(stderr, "Error opening '%s': %s\n", trace_file,
+                strerror(errno));
+        return 1;
+    }
+    char linebuf[LINELEN];
+    unsigned long long trace_num = 0;
+    int ret = 0;
+    while (fgets(linebuf, LINELEN, tfp) != NULL) {
+        trace_op op;
+        if (parse_trace_line(linebuf, &op) == 1) {
+            fprintf(stderr, "Error in trace file -- %s\n", trace_file);
+            ret = 1;
+            break;
+        }
+        simulate_op(info, c, stats, &op, trace_num);
+        trace_num++;
+    }
+    fclose(tfp);
+    return ret;
+}
+
+/**
+ * @brief Worker loop of the batch pool.
+ *     Claims jobs until the queue is empty. The worker keeps its cache
+ *     arena between jobs: when the next job's geometry matches, the
+ *     arena is reset with memsets instead of reallocated, so a
+ *     manifest sorted by geometry allocates once per worker.
+ *
+ * @param[in] arg : the batch_pool to draw jobs from
+ *
+ * @return NULL always; outcomes are in the jobs' result fields
+ */
+void *batch_main(void *arg) {
+    batch_pool *p = arg;
+    cache c = NULL;
+    unsigned long int have_s = 0;
+    unsigned long int have_E = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        unsigned long int i = p->next++;
+        pthread_mutex_unlock(&p->lock);
+        if (i >= p->job_num)
+            break;
+        batch_job *job = &p->jobs[i];
+
+        if (c != NULL && have_s == job->info.s && have_E == job->info.E) {
+            cache_reset(&job->info, c);
+        } else {
+            if (c != NULL)
+                cache_free(c);
+            int cache_result = 0;
+            c = make_cache(&job->info, &cache_result);
+            if (cache_result != 0) {
+                fprintf(stderr, "Memory error when allocating cache.");
+                if (c != NULL)
+                    cache_free(c);
+                c = NULL;
+                job->result = 2;
+                continue;
+            }
+            have_s = job->info.s;
+            have_E = job->info.E;
+        }
+        struct timespec rt0, rt1;
+        timespec_get(&rt0, TIME_UTC);
+        job->result = batch_replay(&job->info, c, &job->stats,
+                                   job->trace_file);
+        timespec_get(&rt1, TIME_UTC);
+        job->seconds = (double)(rt1.tv_sec - rt0.tv_sec) +
+                       (double)(rt1.tv_nsec - rt0.tv_nsec) / 1e9;
+    }
+    if (c != NULL)
+        cache_free(c);
+    return NULL;
+}
+
+/**
+ * @brief Runs every job of a batch manifest on a thread pool.
+ *     The manifest holds one `s,E,b,trace` job per line. All jobs run
+ *     inside this process, so startup, allocation, and file costs are
+ *     paid once per worker rather than once per simulation; results
+ *     print in manifest order once every job has finished, and one
+ *     --results line is appended per job when that flag is armed.
+ *
+ * @param[in] batch_file   : path of the manifest file
+ * @param[in] nthreads     : workers to run (0 picks the online cores)
+ * @param[in] results_file : --results file, or NULL when not armed
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int run_batch(const char *batch_file, unsigned long int nthreads,
+              const char *results_file) {
+    FILE *mfp = fopen(batch_file, "rt");
+    if (!mfp) {
+        fprintf(stderr, "Error opening '%s': %s\n", batch_file,
+                strerror(errno));
+        return 1;
+    }
+
+    batch_pool pool = {NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+    unsigned long int cap = 0;
+    char linebuf[BATCH_LINELEN];
+    while (fgets(linebuf, BATCH_LINELEN, mfp) != NULL) {
+        if (linebuf[0] == '\n' || linebuf[0] == '#')
+            continue;
+        if (pool.job_num == cap) {
+            cap = cap == 0 ? 64 : cap * 2;
+            batch_job *grown = realloc(pool.jobs, sizeof(batch_job) * cap);
+            if (grown == NULL) {
+                fprintf(stderr, "Memory error when allocating batch.");
+                fclose(mfp);
+                for (unsigned long int i = 0; i < pool.job_num; i++)
+                    free(pool.jobs[i].trace_file);
+                free(pool.jobs);
+                return 1;
+            }
+            pool.jobs = grown;
+        }
+        batch_job *job = &pool.jobs[pool.job_num];
+        memset(job, 0, sizeof(*job));
+
+        cache_info info = &job->info;
+        int off = 0;
+        if (sscanf(linebuf, "%lu,%lu,%lu,%n", &info->s, &info->E, &info->b,
+                   &off) != 3 ||
+            off == 0 || info->E == 0 || info->s + info->b > 64) {
+            fprintf(stderr, "Invalid batch manifest line -- %s", linebuf);
+            fclose(mfp);
+            for (unsigned long int i = 0; i < pool.job_num; i++)
+                free(pool.jobs[i].trace_file);
+            free(pool.jobs);
+            return 1;
+        }
+        char *path = &linebuf[off];
+        path[strcspn(path, "\n")] = '\0';
+        job->trace_file = malloc(strlen(path) + 1);
+        if (job->trace_file == NULL) {
+            fprintf(stderr, "Memory error when allocating batch.");
+            fclose(mfp);
+            for (unsigned long int i = 0; i < pool.job_num; i++)
+                free(pool.jobs[i].trace_file);
+            free(pool.jobs);
+            return 1;
+        }
+        strcpy(job->trace_file, path);
+        info->set_num = 1UL << info->s;
+        info->v_flag = false;
+        info->stream_flag = false;
+        info->policy = POLICY_LRU;
+        info->sample = 1;
+        info->hash = HASH_RAW;
+        pool.job_num++;
+    }
+    fclose(mfp);
+    if (pool.job_num == 0) {
+        fprintf(stderr, "Empty batch manifest -- %s\n", batch_file);
+        free(pool.jobs);
+        return 1;
+    }
+
+    if (nthreads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = online > 0 ? (unsigned long int)online : 1;
+    }
+    if (nthreads > pool.job_num)
+        nthreads = pool.job_num;
+    if (nthreads > SHARD_MAX_THREADS)
+        nthreads = SHARD_MAX_THREADS;
+
+    pthread_t threads[SHARD_MAX_THREADS];
+    for (unsigned long int k = 0; k < nthreads; k++)
+        pthread_create(&threads[k], NULL, batch_main, &pool);
+    for (unsigned long int k = 0; k < nthreads; k++)
+        pthread_join(threads[k], NULL);
+
+    int ret = 0;
+    for (unsigned long int i = 0; i < pool.job_num; i++) {
+        batch_job *job = &pool.jobs[i];
+        printf("job %lu s=%lu E=%lu b=%lu %s\n", i, job->info.s, job->info.E,
+               job->info.b, job->trace_file);
+        if (job->result == 0) {
+            printSummary(&job->stats);
+            if (results_file != NULL &&
+                results_append(results_file, &job->info, job->trace_file,
+                               &job->stats,
+                               job->stats.hits + job->stats.misses,
+                               job->seconds, false, 0) == 1)
+                ret = 1;
+        } else {
+            ret = 1;
+        }
+        free(job->trace_file);
+    }
+    free(pool.jobs);
+    return ret;
+}
+
+/** @brief Longest --results line --compare accepts. */
+#define COMPARE_LINELEN 512
+
+/** @brief Fractional throughput drop below which --compare stays quiet. */
+#define COMPARE_NOISE 0.05
+
+/**
+ * @brief Reads one numeric field out of a --results line.
+ *
+ * @param[in] line : the JSON result line
+ * @param[in] key  : field name without quotes
+ * @param[in] val  : field value written here on success
+ *
+ * @return 1 : if the field is missing
+ * @return 0 : if val filled in
+ */
+int result_field(const char *line, const char *key, double *val) {
+    char pat[32];
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    const char *at = strstr(line, pat);
+    if (at == NULL)
+        return 1;
+    *val = strtod(at + strlen(pat), NULL);
+    return 0;
+}
+
+/**
+ * @brief Diffs two --results files run by run (csim --compare).
+ *     Lines pair up by position, so comparable files come from the
+ *     same sweep, batch, or script order. The simulator is fully
+ *     deterministic for a given configuration, so any counter change
+ *     at all is a behavior change and is flagged. Throughput is one
+ *     sample per run, not a distribution, so statistical significance
+ *     is approximated by a fixed noise threshold: only drops beyond
+ *     COMPARE_NOISE are reported as regressions.
+ *
+ * @param[in] old_file : baseline --results file
+ * @param[in] new_file : candidate --results file
+ *
+ * @return 1 if errors in execution or differences flagged.
+ * @return 0 if no errors in execution.
+ */
+int run_compare(const char *old_file, const char *new_file) {
+    FILE *ofp = fopen(old_file, "rt");
+    if (ofp == NULL) {
+        fprintf(stderr, "Error opening '%s': %s\n", old_file, strerror(errno));
+        return 1;
+    }
+    FILE *nfp = fopen(new_file, "rt");
+    if (nfp == NULL) {
+        fprintf(stderr, "Error opening '%s': %s\n", new_file, strerror(errno));
+        fclose(ofp);
+        return 1;
+    }
+
+    static const char *counters[] = {"hits", "misses", "evictions",
+                                     "dirty_bytes", "dirty_evictions"};
+    char oline[COMPARE_LINELEN];
+    char nline[COMPARE_LINELEN];
+    unsigned long int run_num = 0;
+    unsigned long int flagged = 0;
+
+    for (;;) {
+        char *o = fgets(oline, COMPARE_LINELEN, ofp);
+        char *n = fgets(nline, COMPARE_LINELEN, nfp);
+        if (o == NULL && n == NULL)
+            break;
+        if (o == NULL || n == NULL) {
+            fprintf(stderr, "Result files hold different run counts.\n");
+            flagged++;
+            break;
+        }
+
+        bool diff = false;
+        for (unsigned long int i = 0; i < 5; i++) {
+            double ov, nv;
+            if (result_field(oline, counters[i], &ov) == 1 ||
+                result_field(nline, counters[i], &nv) == 1) {
+                fprintf(stderr, "Invalid result format at run %lu\n", run_num);
+                fclose(ofp);
+                fclose(nfp);
+                return 1;
+            }
+            if (ov != nv) {
+                printf("run %lu: %s %.0f -> %.0f\n", run_num, counters[i], ov,
+                       nv);
+                diff = true;
+            }
+        }
+        if (diff)
+            flagged++;
+
+        double othr, nthr;
+        if (result_field(oline, "ops_per_sec", &othr) == 0 &&
+            result_field(nline, "ops_per_sec", &nthr) == 0 && othr > 0 &&
+            nthr < othr * (1.0 - COMPARE_NOISE)) {
+            printf("run %lu: throughput %.0f -> %.0f ops/s (%.1f%%)\n",
+                   run_num, othr, nthr, 100.0 * (nthr - othr) / othr);
+            flagged++;
+        }
+        run_num++;
+    }
+
+    printf("%lu runs compared, %lu flagged\n", run_num, flagged);
+    fclose(ofp);
+    fclose(nfp);
+    return flagged > 0 ? 1 : 0;
+}
+
+/**
+ * @brief Parses command line arguments, executes simulation accordingly.
+ *     Initially stores all info into cache_info.
+ *     Then creates trace, cache, simulation in order.
+ *
+ * @param[in] argc : Length of command line input
+ * @param[in] argv : Command line input string
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int main(int argc, char **argv) {
+    cache_info info = malloc(sizeof(struct cache_info_struct));
+
+    info->s = 0;
+    info->E = 0;
+    info->b = 0;
+    info->v_flag = false;
+    info->stream_flag = false;
+    info->policy = POLICY_LRU;
+    info->sample = 1;
+    info->hash = HASH_RAW;
+
+    bool h_flag = false;
+    int opt_n = 0;
+    int opt;
+    char *filename = NULL;
+    char *sweep_file = NULL;
+    char *log_file = NULL;
+    char *levels_spec = NULL;
+    char *save_file = NULL;
+    char *resume_file = NULL;
+    char *stats_file = NULL;
+    unsigned long int stats_window = ISTATS_WINDOW_DEFAULT;
+    pf_mode pf_sel = PF_OFF;
+    char *shared_spec = NULL;
+    char *batch_file = NULL;
+    bool time_flag = false;
+    unsigned long int hit_cycles = HIT_CYCLES;
+    unsigned long int miss_cycles = MISS_CYCLES;
+    unsigned long int wb_cycles = MISS_CYCLES;
+    char *trace_files[MESI_MAX_CORES];
+    unsigned long int core_num = 0;
+    unsigned long int nthreads = 0;
+    unsigned long int victim_entries = 0;
+    unsigned long int stbuf_entries = 0;
+    char *tlb_spec = NULL;
+    unsigned long int tlb_cycles = MISS_CYCLES;
+    char *results_file = NULL;
+    char *compare_file = NULL;
+    bool profile_flag = false;
+
+    // long-only options; modes without a natural single-letter flag
+    static struct option long_opts[] = {
+        {"stream", no_argument, NULL, 1},
+        {"sweep", required_argument, NULL, 2},
+        {"threads", required_argument, NULL, 3},
+        {"log", required_argument, NULL, 4},
+        {"levels", required_argument, NULL, 5},
+        {"policy", required_argument, NULL, 6},
+        {"sample", required_argument, NULL, 7},
+        {"save", required_argument, NULL, 8},
+        {"resume", required_argument, NULL, 9},
+        {"stats", required_argument, NULL, 10},
+        {"window", required_argument, NULL, 11},
+        {"prefetch", required_argument, NULL, 12},
+        {"shared", required_argument, NULL, 13},
+        {"batch", required_argument, NULL, 14},
+        {"time", optional_argument, NULL, 15},
+        {"hash", required_argument, NULL, 16},
+        {"victim", required_argument, NULL, 17},
+        {"stbuf", required_argument, NULL, 18},
+        {"tlb", required_argument, NULL, 19},
+        {"results", required_argument, NULL, 20},
+        {"compare", required_argument, NULL, 21},
+        {"profile", no_argument, NULL, 22},
+        {NULL, 0, NULL, 0}};
+
+    do {
+        opt = getopt_long(argc, argv, "hvs:b:E:t:", long_opts, NULL);
+        switch (opt) {
+        case 1:
+            info->stream_flag = true;
+            break;
+        case 2:
+            sweep_file = optarg;
+            break;
+        case 3:
+            errno = 0;
+            nthreads = strtoul(optarg, NULL, 0);
+            if (check_strtoul(nthreads,
+                              "Invalid option argument -- 'threads'") == 1 ||
+                nthreads == 0 || nthreads > SHARD_MAX_THREADS)
+                return 1;
+            break;
+        case 4:
+            log_file = optarg;
+            break;
+        case 5:
+            levels_spec = optarg;
+            break;
+        case 6:
+            if (strcmp(optarg, "lru") == 0)
+                info->policy = POLICY_LRU;
+            else if (strcmp(optarg, "plru") == 0)
+                info->policy = POLICY_PLRU;
+            else if (strcmp(optarg, "rand") == 0)
+                info->policy = POLICY_RAND;
+            else if (strcmp(optarg, "srrip") == 0)
+                info->policy = POLICY_SRRIP;
+            else {
+                fprintf(stderr, "Invalid option argument -- 'policy'\n");
+                return 1;
+            }
+            break;
+        case 7:
+            errno = 0;
+            info->sample = strtoul(optarg, NULL, 0);
+            if (check_strtoul(info->sample,
+                              "Invalid option argument -- 'sample'") == 1 ||
+                info->sample == 0)
+                return 1;
+            break;
+        case 8:
+            save_file = optarg;
+            break;
+        case 9:
+            resume_file = optarg;
+            break;
+        case 10:
+            stats_file = optarg;
+            break;
+        case 11:
+            errno = 0;
+            stats_window = strtoul(optarg, NULL, 0);
+            if (check_strtoul(stats_window,
+                              "Invalid option argument -- 'window'") == 1)
+                return 1;
+            break;
+        case 12:
+            if (strcmp(optarg, "nextline") == 0)
+                pf_sel = PF_NEXTLINE;
+            else if (strcmp(optarg, "stride") == 0)
+                pf_sel = PF_STRIDE;
+            else {
+                fprintf(stderr, "Invalid option argument -- 'prefetch'\n");
+                return 1;
+            }
+            break;
+        case 13:
+            shared_spec = optarg;
+            break;
+        case 14:
+            batch_file = optarg;
+            break;
+        case 15:
+            time_flag = true;
+            if (optarg != NULL) {
+                int got = sscanf(optarg, "%lu:%lu:%lu:%lu", &hit_cycles,
+                                 &miss_cycles, &wb_cycles, &tlb_cycles);
+                if (got != 3 && got != 4) {
+                    fprintf(stderr, "Invalid option argument -- 'time'\n");
+                    return 1;
+                }
+            }
+            break;
+        case 16:
+            if (strcmp(optarg, "raw") == 0)
+                info->hash = HASH_RAW;
+            else if (strcmp(optarg, "xor") == 0)
+                info->hash = HASH_XOR;
+            else if (strcmp(optarg, "skew") == 0)
+                info->hash = HASH_SKEW;
+            else {
+                fprintf(stderr, "Invalid option argument -- 'hash'\n");
+                return 1;
+            }
+            break;
+        case 17:
+            errno = 0;
+            victim_entries = strtoul(optarg, NULL, 0);
+            if (check_strtoul(victim_entries,
+                              "Invalid option argument -- 'victim'") == 1 ||
+                victim_entries == 0 || victim_entries > VC_MAX_ENTRIES)
+                return 1;
+            break;
+        case 18:
+            errno = 0;
+            stbuf_entries = strtoul(optarg, NULL, 0);
+            if (check_strtoul(stbuf_entries,
+                              "Invalid option argument -- 'stbuf'") == 1 ||
+                stbuf_entries == 0 || stbuf_entries > VC_MAX_ENTRIES)
+                return 1;
+            break;
+        case 19:
+            tlb_spec = optarg;
+            break;
+        case 20:
+            results_file = optarg;
+            break;
+        case 21:
+            compare_file = optarg;
+            break;
+        case 22:
+            profile_flag = true;
+            break;
+        case 'h':
+            h_flag = true;
+            opt = -1;
+            break;
+        case 'v':
+            info->v_flag = true;
+            break;
+        case 's':
+            errno = 0;
+            info->s = strtoul(optarg, NULL, 0);
+            if (check_strtoul(info->s, "Invalid option argument -- 's'") == 1)
+                return 1;
+            opt_n++;
+            break;
+        case 'E':
+            errno = 0;
+            info->E = strtoul(optarg, NULL, 0);
+            if (check_strtoul(info->E, "Invalid option argument -- 'E'") == 1 ||
+                (signed long int)info->E == 0)
+                return 1;
+            opt_n++;
+            break;
+        case 'b':
+            errno = 0;
+            info->b = strtoul(optarg, NULL, 0);
+            if (check_strtoul(info->b, "Invalid option argument -- 'b'") == 1)
+                return 1;
+            opt_n++;
+            break;
+        case 't':
+            if (core_num == MESI_MAX_CORES) {
+                fprintf(stderr, "Too many trace files (max %d)\n",
+                        MESI_MAX_CORES);
+                return 1;
+            }
+            trace_files[core_num++] = optarg;
+            if (core_num == 1) {
+                filename = optarg;
+                opt_n++;
+            }
+            break;
+        default:
+            opt = -1;
+        }
+    } while (opt != -1);
+
+    if (h_flag) {
+        printf("csim.c info:\n");
+        help_msg();
+        return 1;
+    }
+    if (compare_file != NULL) {
+        // the second result file is the remaining positional argument
+        if (optind >= argc) {
+            fprintf(stderr, "--compare needs two result files.\n");
+            return 1;
+        }
+        free(info);
+        return run_compare(compare_file, argv[optind]);
+    }
+    if (batch_file != NULL) {
+        free(info);
+        return run_batch(batch_file, nthreads, results_file);
+    }
+    if (sweep_file != NULL) {
+        if (filename == NULL) {
+            printf("Mandatory arguments missing or zero.\n");
+            help_msg();
+            return 1;
+        }
+        free(info);
+        return run_sweep(sweep_file, filename, results_file);
+    }
+    if (levels_spec != NULL) {
+        // a hierarchy prints one summary per level; a result line
+        // describes one cache, so there is nothing sensible to write
+        if (results_file != NULL) {
+            fprintf(stderr, "--results cannot be combined with --levels.\n");
+            return 1;
+        }
+        if (filename == NULL) {
+            printf("Mandatory arguments missing or zero.\n");
+            help_msg();
+            return 1;
+        }
+        free(info);
+        return run_hierarchy(levels_spec, filename);
+    }
+    if (opt_n != 4) {
+        printf("Mandatory arguments missing or zero.\n");
+        help_msg();
+        return 1;
+    }
+    // sampling skips operations without counting them, which would
+    // corrupt the trace offset snapshots record
+    if ((save_file != NULL || resume_file != NULL) && info->sample > 1) {
+        fprintf(stderr, "Snapshots cannot be combined with --sample.\n");
+        return 1;
+    }
+    // prefetch installs into arbitrary sets, which would race across
+    // shards and pollute sets a sampled run never simulates
+    if (pf_sel != PF_OFF && (nthreads > 0 || info->sample > 1)) {
+        fprintf(stderr,
+                "Prefetching cannot be combined with --threads or "
+                "--sample.\n");
+        return 1;
+    }
+    if (info->s + info->b > 64) {
+        fprintf(stderr, "Arguments s, b represent > 64 addressable bits.\n");
+        return 1;
+    }
+    if (info->policy == POLICY_PLRU &&
+        (info->E > 64 || (info->E & (info->E - 1)) != 0)) {
+        fprintf(stderr, "Policy plru requires power-of-two E <= 64.\n");
+        return 1;
+    }
+    // the rand victim draws advance one shared xorshift state, which
+    // shard workers would race on -- undefined behavior, and it breaks
+    // the fixed-seed repeatability the policy promises
+    if (info->policy == POLICY_RAND && nthreads > 0) {
+        fprintf(stderr, "Policy rand cannot be combined with --threads.\n");
+        return 1;
+    }
+    // a skewed block has no single set, so everything that maps an
+    // address to one set -- sharding, sampling, per-set stats, the
+    // prefetcher's tag probes, the coherent mode -- cannot apply; the
+    // skew kernel itself keeps only LRU order stamps
+    if (info->hash == HASH_SKEW &&
+        (info->policy != POLICY_LRU || nthreads > 0 || info->sample > 1 ||
+         pf_sel != PF_OFF || stats_file != NULL || shared_spec != NULL)) {
+        fprintf(stderr,
+                "Hash skew requires policy lru and cannot be combined "
+                "with --threads, --sample, --prefetch, --stats, or "
+                "--shared.\n");
+        return 1;
+    }
+    // the coherent mode's private caches index with raw bits only
+    if (info->hash == HASH_XOR && shared_spec != NULL) {
+        fprintf(stderr, "Hash xor cannot be combined with --shared.\n");
+        return 1;
+    }
+    // the buffers are one global structure on the miss path: shards
+    // would race on it, prefetch fills would bypass it, skewed blocks
+    // have no set row to snapshot, and snapshots do not serialize it
+    if ((victim_entries > 0 || stbuf_entries > 0) &&
+        (nthreads > 0 || pf_sel != PF_OFF || info->hash == HASH_SKEW ||
+         shared_spec != NULL || save_file != NULL || resume_file != NULL)) {
+        fprintf(stderr,
+                "--victim and --stbuf cannot be combined with --threads, "
+                "--prefetch, --hash skew, --shared, or snapshots.\n");
+        return 1;
+    }
+    // the TLB is one global structure consulted on every operation, so
+    // shard workers would race on it
+    if (tlb_spec != NULL && nthreads > 0) {
+        fprintf(stderr, "--tlb cannot be combined with --threads.\n");
+        return 1;
+    }
+    // the profile counters are one global structure and the depth
+    // probe maps an address to one set, so shard workers would race
+    // on them and a skewed block has no set row to probe
+    if (profile_flag && (nthreads > 0 || info->hash == HASH_SKEW)) {
+        fprintf(stderr,
+                "--profile cannot be combined with --threads or "
+                "--hash skew.\n");
+        return 1;
+    }
+
+    info->set_num = 1UL << (info->s);
+
+    if (shared_spec != NULL) {
+        // the coherent mode sums per-core caches into one summary,
+        // which no single-geometry result line describes
+        if (results_file != NULL) {
+            fprintf(stderr, "--results cannot be combined with --shared.\n");
+            return 1;
+        }
+        int mesi_result = run_mesi(info, shared_spec, trace_files, core_num);
+        free(info);
+        return mesi_result;
+    }
+    if (core_num > 1) {
+        fprintf(stderr, "Multiple -t traces require --shared.\n");
+        return 1;
+    }
+
+    // Above this point parsing command line into cache_info. Below simulation
+
+    // armed before the setup phases so parsing and allocation time is
+    // attributed too
+    prof.active = profile_flag;
+
+    bool binary_trace = trace_is_binary(filename);
+
+    traces trace = NULL;
+    trace_chunk pool = NULL;
+    if (!info->stream_flag && !binary_trace && nthreads == 0) {
+        int trace_result = 0;
+        unsigned long long a0 = prof.active ? prof_tick() : 0;
+        trace = make_trace(filename, &pool, &trace_result);
+        if (prof.active)
+            prof.parse_cycles += prof_tick() - a0;
+        if (trace_result != 0) {
+            if (trace_result == 1)
+                fprintf(stderr, "Error in trace file -- %s\n", filename);
+            else // trace_result == 2
+                fprintf(stderr, "Memory error when allocating trace.");
+            trace_pool_free(pool);
+            return 1;
+        }
+    }
+
+    int cache_result = 0;
+    unsigned long long c0 = prof.active ? prof_tick() : 0;
+    cache c = make_cache(info, &cache_result);
+    if (prof.active)
+        prof.alloc_cycles += prof_tick() - c0;
+    if (cache_result != 0) {
+        fprintf(stderr, "Memory error when allocating cache.");
+        if (c != NULL)
+            cache_free(c);
+        return 1;
+    }
+
+    if (resume_file != NULL && snapshot_load(info, c, resume_file) == 1) {
+        trace_pool_free(pool);
+        cache_free(c);
+        return 1;
+    }
+
+    // event logging races across shards, so only sequential modes log
+    if (nthreads == 0 && (info->v_flag || log_file != NULL)) {
+        if (log_open(log_file) == 1) {
+            cache_free(c);
+            return 1;
+        }
+    }
+
+    if (pf_sel != PF_OFF && pf_open(info, pf_sel) == 1) {
+        trace_pool_free(pool);
+        cache_free(c);
+        return 1;
+    }
+
+    if ((victim_entries > 0 || stbuf_entries > 0) &&
+        vc_open(info, victim_entries, stbuf_entries) == 1) {
+        trace_pool_free(pool);
+        cache_free(c);
+        return 1;
+    }
+
+    if (tlb_spec != NULL && tlb_open(tlb_spec) == 1) {
+        trace_pool_free(pool);
+        cache_free(c);
+        return 1;
+    }
+
+    // per-set counter bumps race across shards, so only sequential
+    // modes keep instrumentation counters
+    if (nthreads == 0 && stats_file != NULL &&
+        istats_open(info, stats_file, stats_window) == 1) {
+        trace_pool_free(pool);
+        cache_free(c);
+        return 1;
+    }
+
+    int simulator_result = 0;
+    csim_stats_t *simulated;
+    struct timespec rt0, rt1; // wall time of the replay, for --results
+    timespec_get(&rt0, TIME_UTC);
+    if (nthreads > 0)
+        simulated =
+            simulator_threads(info, filename, c, nthreads, &simulator_result);
+    else if (binary_trace)
+        simulated = simulator_mmap(info, filename, c, &simulator_result);
+    else if (info->stream_flag)
+        simulated = simulator_stream(info, filename, c, &simulator_result);
+    else
+        simulated = simulator(info, trace, c, &simulator_result);
+    timespec_get(&rt1, TIME_UTC);
+    log_close();
+    istats_close(info);
+    if (simulator_result != 0) {
+        if (simulator_result == 1)
+            fprintf(stderr, "Error in trace file -- %s\n", filename);
+        else
+            fprintf(stderr, "Memory error when running simulator.");
+        return 1;
+    }
+    if (snap.active) {
+        // fold the snapshot's counters back in; unsigned wrap keeps
+        // dirty_bytes right even when warm dirty lines were evicted
+        simulated->hits += snap.stats.hits;
+        simulated->misses += snap.stats.misses;
+        simulated->evictions += snap.stats.evictions;
+        simulated->dirty_bytes += snap.stats.dirty_bytes;
+        simulated->dirty_evictions += snap.stats.dirty_evictions;
+    }
+    if (save_file != NULL &&
+        snapshot_save(info, c, simulated, save_file) == 1) {
+        trace_pool_free(pool);
+        cache_free(c);
+        return 1;
+    }
+    if (info->sample > 1) {
+        // scale the sampled counters back up to full-cache estimates.
+        // The hashed subset of sets behaves like an independent draw, so
+        // a binomial 95% interval over the simulated operations bounds
+        // the hit-rate error.
+        unsigned long sampled_ops = simulated->hits + simulated->misses;
+        simulated->hits *= info->sample;
+        simulated->misses *= info->sample;
+        simulated->evictions *= info->sample;
+        simulated->dirty_bytes *= info->sample;
+        simulated->dirty_evictions *= info->sample;
+        if (sampled_ops > 0) {
+            double rate = (double)simulated->hits /
+                          (double)(simulated->hits + simulated->misses);
+            double bound =
+                1.96 * sqrt(rate * (1.0 - rate) / (double)sampled_ops);
+            printf("Sampled 1 in %lu sets (%lu operations); estimated hit "
+                   "rate %.4f +/- %.4f\n",
+                   info->sample, sampled_ops, rate, bound);
+        }
+    }
+    printSummary(simulated);
+    // every event class is already counted exactly, so the cycle
+    // total folds out of the final counters: accesses pay the hit
+    // latency, misses add the penalty, and each dirty eviction
+    // (dirty_evictions is in bytes, one block per writeback) adds
+    // the writeback cost
+    unsigned long long accesses = simulated->hits + simulated->misses;
+    unsigned long long writebacks = simulated->dirty_evictions >> info->b;
+    unsigned long long cycles = accesses * hit_cycles +
+                                simulated->misses * miss_cycles +
+                                writebacks * wb_cycles;
+    if (tlb.active) // each page walk stalls for the TLB-miss cost
+        cycles += tlb.misses * tlb_cycles;
+    if (time_flag)
+        printf("cycles:%llu amat:%.3f\n", cycles,
+               accesses > 0 ? (double)cycles / (double)accesses : 0.0);
+    if (pf.mode != PF_OFF)
+        printf("prefetches:%llu prefetch_hits:%llu\n", pf.issued, pf.useful);
+    pf_close();
+    if (vc.active)
+        printf("victim_swaps:%llu writeback_coalesces:%llu\n", vc.swaps,
+               vc.coalesces);
+    vc_close();
+    if (tlb.active) {
+        printf("tlb_hits:%llu tlb_misses:%llu", tlb.hits, tlb.misses);
+        if (tlb.l2_sets > 0)
+            printf(" tlb_l2_hits:%llu", tlb.l2_hits);
+        printf("\n");
+    }
+    tlb_close();
+
+    if (prof.active) {
+        printf("profile_cycles: kernel:%llu tlb:%llu side:%llu parse:%llu "
+               "alloc:%llu io:%llu ops:%llu\n",
+               prof.kernel_cycles, prof.tlb_cycles, prof.side_cycles,
+               prof.parse_cycles, prof.alloc_cycles, prof.io_cycles,
+               prof.ops);
+        printf("profile_depth:");
+        for (unsigned long int i = 0; i < PROF_DEPTH_MAX; i++)
+            if (prof.depth[i] != 0)
+                printf(" %lu:%llu", i, prof.depth[i]);
+        printf(" miss:%llu\n", prof.depth[PROF_DEPTH_MAX]);
+        memset(&prof, 0, sizeof(prof));
+    }
+
+    if (results_file != NULL) {
+        double seconds = (double)(rt1.tv_sec - rt0.tv_sec) +
+                         (double)(rt1.tv_nsec - rt0.tv_nsec) / 1e9;
+        if (results_append(results_file, info, filename, simulated,
+                           snap.ops_done, seconds, time_flag, cycles) == 1) {
+            trace_pool_free(pool);
+            cache_free(c);
+            return 1;
+        }
+    }
+
+    trace_pool_free(pool);
+    cache_free(c);
+    free(info);
+    free(simulated);
+
+    return 0;
+}
+
+#endif /* CSIM_NO_MAIN */
@@ -0,0 +1,247 @@
+/**
+ * @file csim-bench.c
+ * @brief Benchmark harness for the cache simulator itself
+ *
+ * Synthesizes parameterized access patterns in memory and replays them
+ * through make_cache()/simulate_op() without touching the filesystem,
+ * so optimizations to the simulator can be compared reproducibly. For
+ * each scenario it reports simulated operations per second, cycles per
+ * operation (on x86-64), and peak RSS.
+ *
+ * Scenarios:
+ *     seq     : sequential byte stream through the address space
+ *     stride  : fixed large stride, exercising set conflicts
+ *     chase   : pointer-chase through a random block permutation
+ *     zipf    : zipf-like hot set, most accesses to few hot blocks
+ *
+ * Build: gcc -O2 -DCSIM_NO_MAIN cachesim.c csim-bench.c -lpthread
+ * Usage: ./csim-bench [-n <ops>] [-s <s>] [-E <E>] [-b <b>]
+ *
+ * @author Iltikin Wayet
+ */
+
+#include "csim.h"
+#include <getopt.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+/** @brief Default number of operations per scenario. */
+#define BENCH_DEFAULT_OPS 4000000UL
+
+/**
+ * @brief xorshift64 pseudo-random generator, fixed seed.
+ *     Keeps generated patterns identical across runs and hosts, so
+ *     benchmark numbers are comparable between builds.
+ *
+ * @param[in] state : generator state, updated in place
+ *
+ * @return next 64-bit pseudo-random value
+ */
+unsigned long long bench_rand(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Fills ops with one synthetic scenario's accesses.
+ *
+ * @param[in] name    : scenario name (seq, stride, chase, zipf)
+ * @param[in] ops     : operation array of length op_num to fill
+ * @param[in] op_num  : number of operations to generate
+ * @param[in] b       : block bits of the geometry under test
+ *
+ * @return 1 : if the scenario name is unknown
+ * @return 0 : if ops filled
+ */
+int bench_fill(const char *name, trace_op *ops, unsigned long int op_num,
+               unsigned long int b) {
+    unsigned long long block = 1ULL << b;
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+    if (strcmp(name, "seq") == 0) {
+        for (unsigned long int i = 0; i < op_num; i++) {
+            ops[i].address = (unsigned long long)i * 8;
+            ops[i].size = 8;
+            ops[i].store = (i % 4 == 0);
+        }
+        return 0;
+    }
+
+    if (strcmp(name, "stride") == 0) {
+        // stride of 64 blocks: maps successive accesses to far sets
+        for (unsigned long int i = 0; i < op_num; i++) {
+            ops[i].address = (unsigned long long)i * block * 64;
+            ops[i].size = 8;
+            ops[i].store = (i % 4 == 0);
+        }
+        return 0;
+    }
+
+    if (strcmp(name, "chase") == 0) {
+        // walk a random permutation of 2^16 blocks
+        const unsigned long int n = 1UL << 16;
+        unsigned int *perm = malloc(sizeof(unsigned int) * n);
+        if (perm == NULL)
+            return 1;
+        for (unsigned long int i = 0; i < n; i++)
+            perm[i] = (unsigned int)i;
+        for (unsigned long int i = n - 1; i > 0; i--) {
+            unsigned long int j = bench_rand(&rng) % (i + 1);
+            unsigned int tmp = perm[i];
+            perm[i] = perm[j];
+            perm[j] = tmp;
+        }
+        unsigned long int at = 0;
+        for (unsigned long int i = 0; i < op_num; i++) {
+            ops[i].address = (unsigned long long)at * block;
+            ops[i].size = 8;
+            ops[i].store = false;
+            at = perm[at];
+        }
+        free(perm);
+        return 0;
+    }
+
+    if (strcmp(name, "zipf") == 0) {
+        // zipf-like: power of a uniform variate concentrates on low blocks
+        const unsigned long long range = 1ULL << 20;
+        for (unsigned long int i = 0; i < op_num; i++) {
+            double u = (double)(bench_rand(&rng) >> 11) /
+                       (double)(1ULL << 53);
+            double u4 = (u * u) * (u * u);
+            unsigned long long blk = (unsigned long long)(u4 * (double)range);
+            ops[i].address = blk * block;
+            ops[i].size = 8;
+            ops[i].store = (i % 4 == 0);
+        }
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Runs one scenario and prints its throughput report.
+ *
+ * @param[in] name   : scenario name
+ * @param[in] info   : geometry under test
+ * @param[in] ops    : pre-generated operation array
+ * @param[in] op_num : number of operations
+ *
+ * @return 1 if errors in execution.
+ * @return 0 if no errors in execution.
+ */
+int bench_run(const char *name, cache_info info, trace_op *ops,
+              unsigned long int op_num) {
+    int cache_result = 0;
+    cache c = make_cache(info, &cache_result);
+    if (cache_result != 0) {
+        fprintf(stderr, "Memory error when allocating cache.");
+        if (c != NULL)
+            cache_free(c);
+        return 1;
+    }
+
+    csim_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+#ifdef __x86_64__
+    unsigned long long c0 = __rdtsc();
+#endif
+
+    for (unsigned long int i = 0; i < op_num; i++)
+        simulate_op(info, c, &stats, &ops[i], i);
+
+#ifdef __x86_64__
+    unsigned long long c1 = __rdtsc();
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double sec = (double)(t1.tv_sec - t0.tv_sec) +
+                 (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("%-8s %10.0f ops/s", name, (double)op_num / sec);
+#ifdef __x86_64__
+    printf("  %6.1f cycles/op", (double)(c1 - c0) / (double)op_num);
+#endif
+    printf("  %8ld KB peak RSS  (hits %lu misses %lu evictions %lu)\n",
+           ru.ru_maxrss, stats.hits, stats.misses, stats.evictions);
+
+    cache_free(c);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct cache_info_struct info;
+    info.s = 6; // Haswell-like L1 geometry by default
+    info.E = 8;
+    info.b = 6;
+    info.v_flag = false;
+    info.stream_flag = false;
+    info.policy = POLICY_LRU;
+    info.sample = 1;
+    info.hash = HASH_RAW;
+
+    unsigned long int op_num = BENCH_DEFAULT_OPS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:E:b:")) != -1) {
+        switch (opt) {
+        case 'n':
+            op_num = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            info.s = strtoul(optarg, NULL, 0);
+            break;
+        case 'E':
+            info.E = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            info.b = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-n <ops>] [-s <s>] [-E <E>] [-b <b>]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (op_num == 0 || info.E == 0 || info.s + info.b > 64) {
+        fprintf(stderr, "Invalid benchmark parameters.\n");
+        return 1;
+    }
+    info.set_num = 1UL << info.s;
+
+    trace_op *ops = malloc(sizeof(trace_op) * op_num);
+    if (ops == NULL) {
+        fprintf(stderr, "Memory error when allocating benchmark.");
+        return 1;
+    }
+
+    printf("csim-bench: %lu ops per scenario, s=%lu E=%lu b=%lu\n", op_num,
+           info.s, info.E, info.b);
+
+    const char *scenarios[] = {"seq", "stride", "chase", "zipf"};
+    for (unsigned long int i = 0; i < 4; i++) {
+        if (bench_fill(scenarios[i], ops, op_num, info.b) == 1 ||
+            bench_run(scenarios[i], &info, ops, op_num) == 1) {
+            free(ops);
+            return 1;
+        }
+    }
+
+    free(ops);
+    return 0;
+}
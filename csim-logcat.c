@@ -0,0 +1,60 @@
+/**
+ * @file csim-logcat.c
+ * @brief Pretty-printer for binary event logs written by csim --log
+ *
+ * Reads a binary event log (see log_rec in tracefmt.h) and prints one
+ * line per operation in the same format the simulator's verbose mode
+ * uses, so the cheap binary log collected at full replay speed can be
+ * inspected as text afterwards.
+ *
+ * Usage: ./csim-logcat <event log>
+ *
+ * @author Iltikin Wayet
+ */
+
+#include "tracefmt.h"
+
+/** @brief Number of records read per batch. */
+#define LOGCAT_BATCH 4096
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <event log>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "Error opening '%s': %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    char magic[TRACE_MAGIC_LEN];
+    if (fread(magic, 1, TRACE_MAGIC_LEN, in) != TRACE_MAGIC_LEN ||
+        memcmp(magic, LOG_MAGIC, TRACE_MAGIC_LEN) != 0) {
+        fprintf(stderr, "Not a csim event log -- %s\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+
+    log_rec batch[LOGCAT_BATCH];
+    size_t got;
+    while ((got = fread(batch, sizeof(log_rec), LOGCAT_BATCH, in)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            const log_rec *rec = &batch[i];
+            char op_char = rec->store ? 'S' : 'L';
+            const char *outcome =
+                rec->hit ? "hit " : (rec->eviction ? "miss eviction " : "miss ");
+            printf("%c %llu,%u %s\n", op_char, rec->address, rec->size,
+                   outcome);
+        }
+    }
+
+    if (ferror(in)) {
+        fprintf(stderr, "Error reading '%s': %s\n", argv[1], strerror(errno));
+        fclose(in);
+        return 1;
+    }
+    fclose(in);
+    return 0;
+}
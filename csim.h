@@ -0,0 +1,164 @@
+/**
+ * @file csim.h
+ * @brief Core cache-simulation types and entry points
+ *
+ * Declares the cache model shared by the csim command line tool and
+ * the tools that drive the simulator in-process (e.g. csim-bench).
+ * Compile cachesim.c with -DCSIM_NO_MAIN to link it into another
+ * program without its main().
+ */
+
+#ifndef CSIM_H
+#define CSIM_H
+
+#include "cachehelper.h"
+#include "tracefmt.h"
+
+/**
+ * @brief Replacement policies selectable with --policy.
+ *     Each policy has its own compile-time-specialized simulation
+ *     kernel; there is no per-operation indirect dispatch.
+ */
+typedef enum {
+    POLICY_LRU = 0, /* least recently used (default) */
+    POLICY_PLRU,    /* tree pseudo-LRU; needs power-of-two E <= 64 */
+    POLICY_RAND,    /* uniform random victim, fixed-seed xorshift */
+    POLICY_SRRIP    /* static re-reference interval prediction, 2-bit */
+} csim_policy;
+
+/**
+ * @brief Set-index functions selectable with --hash.
+ *     Like the policies, each has its own compile-time-specialized
+ *     kernel, so the default raw-bits path keeps its single-shift
+ *     index computation.
+ */
+typedef enum {
+    HASH_RAW = 0, /* raw address bits above b (default) */
+    HASH_XOR,     /* low tag bits XOR-folded into the index */
+    HASH_SKEW     /* skewed-associative: distinct hash per way */
+} csim_hash;
+
+/**
+ * @brief Data structure to hold cache basic information.
+ *     Information defined by user.
+ *
+ * @arg s           : number of set index bits
+ * @arg E           : number of lines per set
+ * @arg b           : number of block bits
+ * @arg set_num     : number of sets
+ * @arg v_flag      : verbose flag (true when -v option given)
+ * @arg stream_flag : streaming flag (true when --stream option given)
+ * @arg policy      : replacement policy (POLICY_LRU unless --policy)
+ * @arg sample      : simulate 1 in sample sets (1 = simulate all)
+ * @arg hash        : set-index function (HASH_RAW unless --hash)
+ */
+typedef struct cache_info_struct *cache_info;
+struct cache_info_struct {
+    unsigned long int s;
+    unsigned long int E;
+    unsigned long int b;
+    unsigned long int set_num;
+    bool v_flag;
+    bool stream_flag;
+    csim_policy policy;
+    unsigned long int sample;
+    csim_hash hash;
+};
+
+/**
+ * @brief Associativity at or above which per-set LRU lists are kept.
+ *     Below this, the linear order-stamp scan is cheaper than list
+ *     maintenance; above it, O(1) victim selection wins.
+ */
+#define LRU_LIST_MIN_E 16
+
+/**
+ * @brief Flat matrix representation of cache memory.
+ *     Lines are stored struct-of-arrays style: one contiguous array
+ *     per field, indexed by (set_index * E + way). Lines of a set are
+ *     therefore adjacent in memory, so scanning a set walks linearly.
+ *
+ *     For high-associativity caches (E >= LRU_LIST_MIN_E) each set
+ *     additionally keeps an intrusive doubly-linked LRU list over its
+ *     ways, so recency updates and victim selection are O(1) instead
+ *     of an O(E) scan over the order stamps. The list arrays are NULL
+ *     when the list is not in use.
+ *
+ * @arg tag      : tag values of the lines
+ * @arg order    : recency of line usage (greater is more recent)
+ * @arg is_valid : cache line valid
+ * @arg has_data : cache line not empty
+ * @arg lru_prev   : way of next-more-recent line (indexed set * E + way)
+ * @arg lru_next   : way of next-less-recent line (indexed set * E + way)
+ * @arg lru_head   : most recently used way of each set (indexed by set)
+ * @arg lru_tail   : least recently used way of each set (indexed by set)
+ * @arg plru       : tree-PLRU bits of each set (POLICY_PLRU only)
+ * @arg rrpv       : 2-bit re-reference values (POLICY_SRRIP only)
+ * @arg rand_state : xorshift state for victim draws (POLICY_RAND only)
+ */
+typedef struct cache_struct *cache;
+struct cache_struct {
+    unsigned long long *tag;
+    unsigned long long *order;
+    bool *is_valid;
+    bool *has_data;
+    unsigned int *lru_prev;
+    unsigned int *lru_next;
+    unsigned int *lru_head;
+    unsigned int *lru_tail;
+    unsigned long long *plru;
+    unsigned char *rrpv;
+    unsigned long long rand_state;
+};
+
+/** @brief Allocates flat matrix representation of cache. */
+cache make_cache(cache_info info, int *result);
+
+/** @brief Resets a cache in place for reuse at the same geometry. */
+void cache_reset(cache_info info, cache c);
+
+/** @brief Frees a cache allocated by make_cache. */
+void cache_free(cache c);
+
+/** @brief Performs a single trace operation; returns true on a hit. */
+bool simulate_op(cache_info info, cache c, csim_stats_t *stats,
+                 const trace_op *op, unsigned long long trace_num);
+
+/**
+ * @brief A reusable in-process simulation context (libcsim).
+ *     Bundles one cache, its geometry, and its counters so external
+ *     replay infrastructure can drive the simulator directly: create
+ *     a context once, push batches of decoded operations through it,
+ *     read the counters at any point, and reset it for the next
+ *     micro-trace without touching the allocator.
+ */
+typedef struct csim_ctx_struct *csim_ctx;
+
+/**
+ * @brief Allocates a simulation context.
+ *
+ * @param[in] s      : number of set index bits
+ * @param[in] E      : number of lines per set
+ * @param[in] b      : number of block bits
+ * @param[in] policy : replacement policy
+ * @param[in] result : value modified if errors
+ *     1 if invalid geometry, 2 if memory error
+ *
+ * @return the context, or NULL on error
+ */
+csim_ctx csim_create(unsigned long int s, unsigned long int E,
+                     unsigned long int b, csim_policy policy, int *result);
+
+/** @brief Simulates a batch of decoded operations in trace order. */
+void csim_push(csim_ctx ctx, const trace_op *ops, unsigned long int op_num);
+
+/** @brief Returns the context's live counters; valid until csim_free. */
+const csim_stats_t *csim_stats_read(csim_ctx ctx);
+
+/** @brief Clears cache state and counters for reuse; no reallocation. */
+void csim_reset(csim_ctx ctx);
+
+/** @brief Frees a context and everything it owns. */
+void csim_free(csim_ctx ctx);
+
+#endif /* CSIM_H */
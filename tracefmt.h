@@ -0,0 +1,147 @@
+/**
+ * @file tracefmt.h
+ * @brief Memory trace formats shared by csim and csim-convert
+ *
+ * Two trace representations exist:
+ *     1. The documented text format, one `Op Addr,Size` line per
+ *        operation. Parsing helpers for it live here so the simulator
+ *        and the converter share one implementation.
+ *     2. A fixed-width binary format: an 8-byte magic header followed
+ *        by packed 16-byte records. Binary traces can be mmap'd and
+ *        replayed in place with no per-record parsing or allocation.
+ */
+
+#ifndef TRACEFMT_H
+#define TRACEFMT_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Magic bytes opening a binary trace file ("CSIMTRC1"). */
+#define TRACE_MAGIC "CSIMTRC1"
+
+/** @brief Length of the magic header in bytes. */
+#define TRACE_MAGIC_LEN 8
+
+/**
+ * @brief A single decoded trace operation, held by value.
+ *
+ * @arg address : memory address to be accessed
+ * @arg size    : number of bytes to be accessed
+ * @arg store   : type of operation; true if 'S', false 'L'
+ */
+typedef struct {
+    unsigned long long address;
+    unsigned long long size;
+    bool store;
+} trace_op;
+
+/**
+ * @brief One fixed-width record of the binary trace format.
+ *     Exactly 16 bytes; a binary trace file is the magic header
+ *     followed by a packed array of these.
+ *
+ * @arg address : memory address to be accessed
+ * @arg size    : number of bytes to be accessed
+ * @arg store   : type of operation; 1 if store, 0 if load
+ * @arg pad     : reserved, written as zero
+ */
+typedef struct {
+    unsigned long long address;
+    unsigned int size;
+    unsigned char store;
+    unsigned char pad[3];
+} trace_rec;
+
+/** @brief Magic bytes opening a binary event log ("CSIMLOG1"). */
+#define LOG_MAGIC "CSIMLOG1"
+
+/**
+ * @brief One fixed-width record of the binary event-log format.
+ *     Written by csim --log for every simulated operation; a log file
+ *     is the magic header followed by a packed array of these. The
+ *     csim-logcat tool prints them in the verbose-output text format.
+ *
+ * @arg address  : memory address that was accessed
+ * @arg size     : number of bytes that were accessed
+ * @arg store    : 1 if store, 0 if load
+ * @arg hit      : 1 if the access hit
+ * @arg eviction : 1 if the access evicted a line
+ * @arg pad      : reserved, written as zero
+ */
+typedef struct {
+    unsigned long long address;
+    unsigned int size;
+    unsigned char store;
+    unsigned char hit;
+    unsigned char eviction;
+    unsigned char pad;
+} log_rec;
+
+/**
+ * @brief Validates strtoul output.
+ *
+ * @param[in] x   : output value to be checked
+ * @param[in] msg : error message to be printed if x invalid
+ *
+ * @return 1 : if invalid strtoul output
+ * @return 0 : if valid strtoul output
+ */
+static inline int check_strtoul(unsigned long int x, const char *msg) {
+    int r = 0;
+    if ((errno == ERANGE && x == ULONG_MAX) || (errno != 0 && x == 0)) {
+        perror("strtoul");
+        r = 1;
+    }
+    if ((signed long int)x < 0)
+        r = 1;
+    if (r == 1)
+        fprintf(stderr, "%s\n", msg);
+    return r;
+}
+
+/**
+ * @brief Parses and validates one line of the text trace format.
+ *
+ * @param[in] linebuf : line in `Op Addr,Size` format; comma overwritten
+ * @param[in] op      : decoded operation written here on success
+ *
+ * @return 1 : if line not in valid trace format
+ * @return 0 : if line valid and op filled in
+ */
+static inline int parse_trace_line(char *linebuf, trace_op *op) {
+    if (linebuf[1] != ' ' || linebuf[2] == ' ' ||
+        (linebuf[0] != 'S' && linebuf[0] != 'L') || strlen(&linebuf[0]) < 5) {
+        fprintf(stderr, "Invalid trace format\n");
+        return 1;
+    }
+    op->store = (linebuf[0] == 'S');
+
+    // split on the comma by hand rather than with strtok: lines are
+    // parsed concurrently in multi-core mode and strtok's global
+    // state would be shared across threads
+    char *sep = strchr(&linebuf[1], ',');
+    if (sep == NULL) {
+        fprintf(stderr, "Invalid trace format\n");
+        return 1;
+    }
+    *sep = '\0';
+
+    errno = 0;
+    op->address = strtoul(&linebuf[1], NULL, 16);
+    if (check_strtoul(op->address, "Invalid address input.") == 1)
+        return 1;
+
+    errno = 0;
+    op->size = strtoul(sep + 1, NULL, 0);
+    if (check_strtoul(op->size, "Invalid size input.") == 1)
+        return 1;
+
+    return 0;
+}
+
+#endif /* TRACEFMT_H */